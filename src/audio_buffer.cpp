@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cstring>
+
+#include "audio_buffer.h"
+
+
+AudioSlabPool::~AudioSlabPool() {
+    while (freeList) {
+        AudioSlab* slab = freeList;
+        freeList = slab->next;
+        delete slab;
+    }
+}
+
+void AudioSlabPool::reserve(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (freeCount < count) {
+        auto* slab = new AudioSlab;
+        slab->next = freeList;
+        freeList = slab;
+        freeCount++;
+        allocated++;
+    }
+}
+
+AudioSlab* AudioSlabPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeList) {
+            AudioSlab* slab = freeList;
+            freeList = slab->next;
+            freeCount--;
+            slab->next = nullptr;
+            return slab;
+        }
+        allocated++;
+    }
+    return new AudioSlab;
+}
+
+void AudioSlabPool::release(AudioSlab* head) {
+    if (!head) return;
+
+    AudioSlab* last = head;
+    size_t count = 1;
+    while (last->next) {
+        last = last->next;
+        count++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    last->next = freeList;
+    freeList = head;
+    freeCount += count;
+}
+
+size_t AudioSlabPool::allocatedSlabs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocated;
+}
+
+size_t AudioSlabPool::freeSlabs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return freeCount;
+}
+
+
+AudioBuffer::AudioBuffer(const std::vector<float>& samples) : pool(std::make_shared<AudioSlabPool>()) {
+    append(samples.data(), samples.size());
+}
+
+AudioBuffer::AudioBuffer(AudioBuffer&& other) noexcept
+        : pool(other.pool), head(other.head), tail(other.tail), length(other.length) {
+    // the moved-from buffer keeps its pool so it can be filled again
+    other.head = nullptr;
+    other.tail = nullptr;
+    other.length = 0;
+}
+
+AudioBuffer& AudioBuffer::operator=(AudioBuffer&& other) noexcept {
+    if (this != &other) {
+        clear();
+        pool = other.pool;
+        head = other.head;
+        tail = other.tail;
+        length = other.length;
+        other.head = nullptr;
+        other.tail = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+void AudioBuffer::append(const float* data, size_t count) {
+    if (!pool && count > 0) pool = std::make_shared<AudioSlabPool>();
+
+    while (count > 0) {
+        size_t used = length % SLAB_FRAMES;
+        if (used == 0) {
+            AudioSlab* slab = pool->acquire();
+            if (tail) tail->next = slab;
+            else head = slab;
+            tail = slab;
+        }
+
+        size_t n = std::min(count, SLAB_FRAMES - used);
+        std::memcpy(tail->samples + used, data, n * sizeof(float));
+        data += n;
+        count -= n;
+        length += n;
+    }
+}
+
+void AudioBuffer::append(const AudioBuffer& other) {
+    other.forEachSpan(0, other.size(), [this](const float* data, size_t count) { append(data, count); });
+}
+
+void AudioBuffer::truncate(size_t count) {
+    if (count >= length) return;
+    if (count == 0) {
+        clear();
+        return;
+    }
+
+    AudioSlab* last = head;
+    for (size_t i = 1; i < (count + SLAB_FRAMES - 1) / SLAB_FRAMES; ++i) last = last->next;
+    pool->release(last->next);
+    last->next = nullptr;
+    tail = last;
+    length = count;
+}
+
+void AudioBuffer::clear() {
+    if (head) pool->release(head);
+    head = nullptr;
+    tail = nullptr;
+    length = 0;
+}
+
+void AudioBuffer::copyTo(size_t begin, size_t count, float* out) const {
+    forEachSpan(begin, count, [&out](const float* data, size_t n) {
+        std::memcpy(out, data, n * sizeof(float));
+        out += n;
+    });
+}
+
+AudioBuffer AudioBuffer::copy(size_t begin, size_t count) const {
+    AudioBuffer result(pool);
+    forEachSpan(begin, count, [&result](const float* data, size_t n) { result.append(data, n); });
+    return result;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef AUDIO_BUFFER_H
+#define AUDIO_BUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+static constexpr size_t SLAB_FRAMES = 16000;    // one second at 16 kHz
+
+struct AudioSlab {
+    float samples[SLAB_FRAMES];
+    AudioSlab* next = nullptr;
+};
+
+// Fixed-size slabs recycled between the recording thread, which fills them, and the consumer,
+// which returns them once a chunk has been transcribed. The pool only grows, so after warm-up
+// capture runs without heap allocations.
+class AudioSlabPool {
+public:
+    AudioSlabPool() = default;
+    ~AudioSlabPool();
+    AudioSlabPool(const AudioSlabPool&) = delete;
+    AudioSlabPool& operator=(const AudioSlabPool&) = delete;
+
+    // Makes sure at least count slabs are free.
+    void reserve(size_t count);
+    AudioSlab* acquire();
+    // Returns a whole chain linked through next.
+    void release(AudioSlab* head);
+
+    size_t allocatedSlabs() const;
+    size_t freeSlabs() const;
+
+private:
+    mutable std::mutex mutex;
+    AudioSlab* freeList = nullptr;
+    size_t freeCount = 0;
+    size_t allocated = 0;
+};
+
+// Mono audio stored as a chain of pool slabs. Move-only: each chain has exactly one owner,
+// so appending never touches memory another buffer can see.
+class AudioBuffer {
+public:
+    // Without a pool, the first append creates a private one.
+    AudioBuffer() = default;
+    explicit AudioBuffer(std::shared_ptr<AudioSlabPool> pool) : pool(std::move(pool)) {}
+    // Copies samples into slabs of a private pool; for audio that does not come from a recorder.
+    explicit AudioBuffer(const std::vector<float>& samples);
+    ~AudioBuffer() { clear(); }
+
+    AudioBuffer(AudioBuffer&& other) noexcept;
+    AudioBuffer& operator=(AudioBuffer&& other) noexcept;
+    AudioBuffer(const AudioBuffer&) = delete;
+    AudioBuffer& operator=(const AudioBuffer&) = delete;
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    void append(const float* data, size_t count);
+    void append(const AudioBuffer& other);
+    // Keeps the first count samples and returns the rest of the slabs to the pool.
+    void truncate(size_t count);
+    void clear();
+
+    void copyTo(size_t begin, size_t count, float* out) const;
+    // A new buffer from the same pool holding samples [begin, begin + count).
+    AudioBuffer copy(size_t begin, size_t count) const;
+
+    // Calls f(const float* data, size_t count) for each contiguous run of [begin, begin + count).
+    template<typename F>
+    void forEachSpan(size_t begin, size_t count, F&& f) const {
+        const AudioSlab* slab = head;
+        while (slab && begin >= SLAB_FRAMES) {
+            slab = slab->next;
+            begin -= SLAB_FRAMES;
+        }
+        while (slab && count > 0) {
+            size_t n = std::min(count, SLAB_FRAMES - begin);
+            f(slab->samples + begin, n);
+            count -= n;
+            begin = 0;
+            slab = slab->next;
+        }
+    }
+
+private:
+    std::shared_ptr<AudioSlabPool> pool;
+    AudioSlab* head = nullptr;
+    AudioSlab* tail = nullptr;
+    size_t length = 0;
+};
+
+#endif //AUDIO_BUFFER_H
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include "audio_file.h"
+
+
+static const int SAMPLE_RATE = 16000;
+static const int FRAMES_PER_BUFFER = 1024;
+
+
+AudioFileReader::AudioFileReader(const std::string& path, ResamplerConfig resamplerConfig) {
+    file = sf_open(path.c_str(), SFM_READ, &info);
+    if (!file) {
+        throw std::runtime_error("Error opening audio file " + path + ": " + sf_strerror(nullptr));
+    }
+    if (info.channels < 1 || info.samplerate <= 0) {
+        sf_close(file);
+        throw std::runtime_error("Unsupported audio layout in " + path);
+    }
+
+    // libsndfile converts every sample format to float in [-1, 1]
+    interleaved.resize(static_cast<size_t>(FRAMES_PER_BUFFER) * info.channels);
+    if (info.samplerate != SAMPLE_RATE) {
+        resampled.reset(Resampler::create(info.samplerate, SAMPLE_RATE, resamplerConfig));
+        fileBuffer.resize(FRAMES_PER_BUFFER);
+    }
+}
+
+AudioFileReader::~AudioFileReader() {
+    if (file) sf_close(file);
+}
+
+uint64_t AudioFileReader::getOutputFrames() const {
+    if (info.frames <= 0 || info.frames >= INT64_MAX / SAMPLE_RATE) return 0;
+    auto frames = static_cast<uint64_t>(info.frames);
+    return (frames * SAMPLE_RATE + info.samplerate - 1) / static_cast<uint64_t>(info.samplerate);
+}
+
+size_t AudioFileReader::read(float* buffer, size_t frames) {
+    if (!resampled.active()) return readMono(buffer, frames);
+
+    while (resampled.available() < frames && !fileEnded) {
+        size_t n = readMono(fileBuffer.data(), fileBuffer.size());
+        if (n == 0) {
+            fileEnded = true;
+            resampled.finish();
+        } else {
+            resampled.push(fileBuffer.data(), n);
+        }
+    }
+    return resampled.pop(buffer, frames);
+}
+
+// At the file's rate. Channels are averaged in float, so loud multi-channel input cannot wrap around.
+size_t AudioFileReader::readMono(float* buffer, size_t frames) {
+    const auto channels = static_cast<size_t>(info.channels);
+    size_t total = 0;
+
+    while (total < frames) {
+        size_t want = std::min(frames - total, static_cast<size_t>(FRAMES_PER_BUFFER));
+        float* target = channels == 1 ? buffer + total : interleaved.data();
+        auto n = static_cast<size_t>(sf_readf_float(file, target, static_cast<sf_count_t>(want)));
+        if (n == 0) break;
+
+        if (channels > 1) {
+            const float scale = 1.0f / static_cast<float>(channels);
+            for (size_t i = 0; i < n; ++i) {
+                float sum = 0.0f;
+                for (size_t c = 0; c < channels; ++c) sum += interleaved[i * channels + c];
+                buffer[total + i] = sum * scale;
+            }
+        }
+        total += n;
+        if (n < want) break;
+    }
+    return total;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef AUDIO_FILE_H
+#define AUDIO_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sndfile.h"
+#include "resampler.h"
+
+
+// Any file libsndfile can decode (8/16/24/32-bit PCM, float, double; any channel count), delivered as
+// mono 16 kHz float blocks. Memory use depends on the block size only, not on the length of the file.
+class AudioFileReader {
+public:
+    explicit AudioFileReader(const std::string& path, ResamplerConfig resamplerConfig = {});
+    ~AudioFileReader();
+    AudioFileReader(const AudioFileReader&) = delete;
+    AudioFileReader& operator=(const AudioFileReader&) = delete;
+
+    // Fills up to frames samples; 0 once the file and the resampler tail are exhausted.
+    size_t read(float* buffer, size_t frames);
+
+    int getSampleRate() const { return info.samplerate; }
+    int getChannels() const { return info.channels; }
+    // Mono 16 kHz frames the whole file will produce; 0 if libsndfile cannot tell (e.g. a pipe).
+    uint64_t getOutputFrames() const;
+
+private:
+    SF_INFO info{};
+    SNDFILE* file = nullptr;
+    std::vector<float> interleaved;
+    std::vector<float> fileBuffer;
+    ResampleFifo resampled;
+    bool fileEnded = false;
+
+    size_t readMono(float* buffer, size_t frames);
+};
+
+#endif //AUDIO_FILE_H
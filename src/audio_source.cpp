@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "audio_source.h"
+
+
+static const int SAMPLE_RATE = 16000;
+static const int CHANNELS = 1;
+static const int FRAMES_PER_BUFFER = 1024;
+static constexpr auto CONSUMER_POLL_INTERVAL = std::chrono::milliseconds(5);
+static const int STOP_POLL_MS = 100;
+
+const PaSampleFormat SAMPLE_FORMAT = paFloat32;
+
+
+PortAudioHandler::PortAudioHandler(){
+    PaError err = Pa_Initialize();
+    if (err != paNoError) throw PortAudioException(err);
+}
+
+PortAudioHandler::~PortAudioHandler(){
+    Pa_Terminate();
+}
+
+void AudioSource::pace(size_t frames) {
+    if (pacing != Pacing::RealTime || frames == 0) return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (!pacingStarted) {
+        pacingStart = now;
+        pacingStarted = true;
+    }
+    deliveredFrames += frames;
+
+    auto due = pacingStart + std::chrono::microseconds(deliveredFrames * 1000000 / SAMPLE_RATE);
+    if (due > now) std::this_thread::sleep_until(due);
+}
+
+
+PortAudioSource::PortAudioSource(CaptureMode captureMode, float ringBufferSeconds, ResamplerConfig resamplerConfig)
+        : AudioSource(Pacing::AsFastAsPossible), captureMode(captureMode), ringBufferSeconds(ringBufferSeconds),
+          resamplerConfig(resamplerConfig) {}
+
+PortAudioSource::~PortAudioSource() {
+    stop();
+}
+
+void PortAudioSource::start() {
+    PaError err = Pa_Initialize();
+    if (err != paNoError) throw PortAudioException(err);
+
+    PaDeviceIndex device = Pa_GetDefaultInputDevice();
+    const PaDeviceInfo* deviceInfo = device == paNoDevice ? nullptr : Pa_GetDeviceInfo(device);
+    if (!deviceInfo) {
+        Pa_Terminate();
+        throw std::runtime_error("No default input device");
+    }
+
+    PaStreamParameters inputParameters{};
+    inputParameters.device = device;
+    inputParameters.channelCount = CHANNELS;
+    inputParameters.sampleFormat = SAMPLE_FORMAT;
+    inputParameters.suggestedLatency = deviceInfo->defaultLowInputLatency;
+
+    deviceRate = SAMPLE_RATE;
+    resampled.reset(nullptr);
+    if (Pa_IsFormatSupported(&inputParameters, nullptr, SAMPLE_RATE) != paFormatIsSupported) {
+        deviceRate = static_cast<int>(deviceInfo->defaultSampleRate);
+        resampled.reset(Resampler::create(deviceRate, SAMPLE_RATE, resamplerConfig));
+        std::cout << "Input device does not support " << SAMPLE_RATE << " Hz, capturing at " << deviceRate
+                  << " Hz and resampling" << std::endl;
+    }
+    // keep the buffer duration of the 16 kHz case
+    auto deviceFrames = static_cast<unsigned long>(FRAMES_PER_BUFFER * static_cast<long>(deviceRate) / SAMPLE_RATE);
+    deviceBuffer.assign(deviceFrames, 0.0f);
+
+    bool useCallback = captureMode == CaptureMode::Callback;
+    if (useCallback) {
+        ringBuffer = std::make_unique<SpscRingBuffer<float>>(
+                static_cast<size_t>(ringBufferSeconds * static_cast<float>(deviceRate)) + deviceFrames);
+    }
+    overrunCount = 0;
+    droppedFrames = 0;
+    stopRequested = false;
+
+    err = Pa_OpenStream(&stream,
+                        &inputParameters,
+                        nullptr,
+                        deviceRate,
+                        deviceFrames,
+                        paNoFlag,
+                        useCallback ? &PortAudioSource::captureCallback : nullptr,
+                        useCallback ? this : nullptr);
+    if (err != paNoError) {
+        Pa_Terminate();
+        throw PortAudioException(err);
+    }
+
+    err = Pa_StartStream(stream);
+    if (err != paNoError) {
+        Pa_CloseStream(stream);
+        stream = nullptr;
+        Pa_Terminate();
+        throw PortAudioException(err);
+    }
+}
+
+void PortAudioSource::stop() {
+    if (!stream) return;
+
+    Pa_StopStream(stream);
+    Pa_CloseStream(stream);
+    stream = nullptr;
+    Pa_Terminate();
+}
+
+size_t PortAudioSource::read(float* buffer, size_t frames) {
+    if (!resampled.active()) return readDevice(buffer, frames);
+
+    while (resampled.available() < frames) {
+        size_t n = readDevice(deviceBuffer.data(), deviceBuffer.size());
+        if (n == 0) return 0;
+        resampled.push(deviceBuffer.data(), n);
+    }
+    return resampled.pop(buffer, frames);
+}
+
+// Reads at the device rate.
+size_t PortAudioSource::readDevice(float* buffer, size_t frames) {
+    if (captureMode == CaptureMode::Callback) {
+        while (ringBuffer->readAvailable() < frames) {
+            if (stopRequested) return 0;
+            std::this_thread::sleep_for(CONSUMER_POLL_INTERVAL);
+        }
+        return ringBuffer->read(buffer, frames);
+    }
+
+    if (stopRequested) return 0;
+    PaError err = Pa_ReadStream(stream, buffer, frames);
+    if (err == paInputOverflowed) {
+        // the buffer is still filled, but audio before it was lost
+        overrunCount++;
+        return frames;
+    }
+    if (err != paNoError) {
+        std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
+        return 0;
+    }
+    return frames;
+}
+
+int PortAudioSource::captureCallback(const void* input, void* /*output*/, unsigned long frameCount,
+                                     const PaStreamCallbackTimeInfo* /*timeInfo*/, PaStreamCallbackFlags statusFlags,
+                                     void* userData) {
+    // runs on the PortAudio real-time thread: no locks, no allocation, no I/O
+    auto* source = static_cast<PortAudioSource*>(userData);
+    if (statusFlags & paInputOverflow) {
+        source->overrunCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (input == nullptr) return paContinue;
+
+    size_t written = source->ringBuffer->write(static_cast<const float*>(input), frameCount);
+    if (written < frameCount) {
+        source->overrunCount.fetch_add(1, std::memory_order_relaxed);
+        source->droppedFrames.fetch_add(frameCount - written, std::memory_order_relaxed);
+    }
+    return paContinue;
+}
+
+
+WavFileSource::WavFileSource(std::string path, Pacing pacing, ResamplerConfig resamplerConfig)
+        : AudioSource(pacing), path(std::move(path)), resamplerConfig(resamplerConfig) {}
+
+WavFileSource::~WavFileSource() {
+    stop();
+}
+
+void WavFileSource::start() {
+    mapped = MappedWav::try_open(path);
+    mappedPosition = 0;
+    if (!mapped) reader = std::make_unique<AudioFileReader>(path, resamplerConfig);
+    stopRequested = false;
+    resetPacing();
+}
+
+void WavFileSource::stop() {
+    reader.reset();
+    mapped.reset();
+}
+
+size_t WavFileSource::read(float* buffer, size_t frames) {
+    if (stopRequested) return 0;
+
+    size_t n = 0;
+    if (mapped) {
+        auto samples = mapped->samples();
+        n = std::min(frames, samples.size() - mappedPosition);
+        convert_pcm16(samples.subspan(mappedPosition, n), buffer);
+        mappedPosition += n;
+    } else if (reader) {
+        n = reader->read(buffer, frames);
+    }
+    pace(n);
+    return n;
+}
+
+
+PcmStreamSource::PcmStreamSource(std::string path, PcmFormat format, Pacing pacing)
+        : AudioSource(pacing), path(std::move(path)), format(format) {}
+
+PcmStreamSource::~PcmStreamSource() {
+    stop();
+}
+
+void PcmStreamSource::start() {
+    if (path.empty() || path == "-") {
+        fd = STDIN_FILENO;
+        ownsFd = false;
+    } else {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open PCM input: " + path);
+        }
+        ownsFd = true;
+    }
+    pending.clear();
+    stopRequested = false;
+    resetPacing();
+}
+
+void PcmStreamSource::stop() {
+    if (ownsFd && fd >= 0) close(fd);
+    fd = -1;
+    ownsFd = false;
+}
+
+size_t PcmStreamSource::read(float* buffer, size_t frames) {
+    const size_t sampleSize = format == PcmFormat::S16LE ? sizeof(int16_t) : sizeof(float);
+
+    // wait for at least one whole sample, checking for a stop request in between
+    while (pending.size() < sampleSize) {
+        if (stopRequested || fd < 0) return 0;
+
+        pollfd pfd{fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, STOP_POLL_MS);
+        if (ready < 0 && errno != EINTR) return 0;
+        if (ready <= 0) continue;
+
+        size_t offset = pending.size();
+        pending.resize(std::max(frames, size_t(1)) * sampleSize);
+        ssize_t n = ::read(fd, pending.data() + offset, pending.size() - offset);
+        if (n <= 0) {
+            pending.resize(offset);
+            if (n == 0 || errno != EINTR) return 0;
+            continue;
+        }
+        pending.resize(offset + static_cast<size_t>(n));
+    }
+
+    size_t count = std::min(frames, pending.size() / sampleSize);
+    for (size_t i = 0; i < count; ++i) {
+        const char* p = pending.data() + i * sampleSize;
+        if (format == PcmFormat::S16LE) {
+            auto sample = static_cast<int16_t>(static_cast<uint8_t>(p[0]) | (static_cast<uint8_t>(p[1]) << 8));
+            buffer[i] = static_cast<float>(sample) / 32768.0f;
+        } else {
+            std::memcpy(&buffer[i], p, sizeof(float));
+        }
+    }
+    pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(count * sampleSize));
+
+    pace(count);
+    return count;
+}
+
+
+void MemorySource::start() {
+    position = 0;
+    stopRequested = false;
+    resetPacing();
+}
+
+size_t MemorySource::read(float* buffer, size_t frames) {
+    if (stopRequested) return 0;
+
+    size_t n = std::min(frames, samples.size() - position);
+    std::copy_n(samples.data() + position, n, buffer);
+    position += n;
+    pace(n);
+    return n;
+}
+
+
+SyntheticSource::SyntheticSource(float durationSeconds, float speechSeconds, float silenceSeconds, Pacing pacing)
+        : AudioSource(pacing),
+          totalFrames(durationSeconds > 0 ? static_cast<uint64_t>(durationSeconds * SAMPLE_RATE) : 0),
+          speechFrames(static_cast<uint64_t>(speechSeconds * SAMPLE_RATE)),
+          periodFrames(static_cast<uint64_t>((speechSeconds + silenceSeconds) * SAMPLE_RATE)),
+          generator(42) {
+    if (periodFrames == 0) {
+        throw std::invalid_argument("Synthetic source needs a non-empty speech/silence period");
+    }
+}
+
+void SyntheticSource::start() {
+    position = 0;
+    generator.seed(42);
+    stopRequested = false;
+    resetPacing();
+}
+
+size_t SyntheticSource::read(float* buffer, size_t frames) {
+    if (stopRequested) return 0;
+    if (totalFrames > 0) {
+        frames = static_cast<size_t>(std::min<uint64_t>(frames, totalFrames - position));
+    }
+
+    constexpr float pi = 3.14159265358979f;
+    std::normal_distribution<float> noise(0.0f, 0.003f);
+    for (size_t i = 0; i < frames; ++i, ++position) {
+        float sample = noise(generator);
+        if (position % periodFrames < speechFrames) {
+            // a few harmonics of a 140 Hz voice, amplitude-modulated at a syllable rate of 4 Hz
+            float t = static_cast<float>(position) / SAMPLE_RATE;
+            float envelope = 0.5f * (1.0f - std::cos(2.0f * pi * 4.0f * t));
+            float voiced = 0.0f;
+            for (int h = 1; h <= 5; ++h) voiced += std::sin(2.0f * pi * 140.0f * h * t) / static_cast<float>(h);
+            sample += 0.1f * envelope * voiced;
+        }
+        buffer[i] = sample;
+    }
+
+    pace(frames);
+    return frames;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "portaudio.h"
+#include "audio_file.h"
+#include "mapped_wav.h"
+#include "resampler.h"
+#include "ring_buffer.h"
+
+
+class PortAudioException : public std::runtime_error {
+public:
+    explicit PortAudioException(PaError err) : std::runtime_error(Pa_GetErrorText(err)), error(err) {}
+    PaError error;
+};
+
+class PortAudioHandler {
+public:
+    PortAudioHandler();
+    ~PortAudioHandler();
+};
+
+enum class Pacing {
+    RealTime,           // deliver audio no faster than it would be captured
+    AsFastAsPossible
+};
+
+// Mono 16 kHz float audio feeding the recorder's VAD and chunking.
+// read() runs on the recording thread; requestStop() may be called from any thread and
+// makes a blocked read() return 0 soon after.
+class AudioSource {
+public:
+    explicit AudioSource(Pacing pacing = Pacing::RealTime) : pacing(pacing) {}
+    virtual ~AudioSource() = default;
+
+    virtual void start() {}
+    virtual void stop() {}
+    // Fills up to frames samples, returns how many were written; 0 means the source has ended.
+    virtual size_t read(float* buffer, size_t frames) = 0;
+
+    void requestStop() { stopRequested = true; }
+
+    virtual uint64_t getOverrunCount() const { return 0; }
+    virtual uint64_t getDroppedFrames() const { return 0; }
+
+protected:
+    std::atomic<bool> stopRequested{false};
+
+    // Sleeps so that delivered audio does not run ahead of the wall clock in RealTime mode.
+    void pace(size_t frames);
+    void resetPacing() { deliveredFrames = 0; pacingStarted = false; }
+
+private:
+    Pacing pacing;
+    bool pacingStarted = false;
+    uint64_t deliveredFrames = 0;
+    std::chrono::steady_clock::time_point pacingStart;
+};
+
+enum class CaptureMode {
+    Blocking,   // Pa_ReadStream on the recording thread
+    Callback    // PortAudio callback feeding a lock-free ring, drained by the recording thread
+};
+
+// The default input device. Devices that cannot capture at 16 kHz run at their default rate and are resampled
+// on the recording thread, never in the PortAudio callback.
+class PortAudioSource : public AudioSource {
+public:
+    explicit PortAudioSource(CaptureMode captureMode = CaptureMode::Callback, float ringBufferSeconds = 2.0f,
+                             ResamplerConfig resamplerConfig = {});
+    ~PortAudioSource() override;
+
+    void start() override;
+    void stop() override;
+    size_t read(float* buffer, size_t frames) override;
+
+    uint64_t getOverrunCount() const override { return overrunCount; }
+    uint64_t getDroppedFrames() const override { return droppedFrames; }
+
+private:
+    CaptureMode captureMode;
+    float ringBufferSeconds;
+    ResamplerConfig resamplerConfig;
+    PaStream* stream = nullptr;
+    int deviceRate = 0;
+    ResampleFifo resampled;
+    std::vector<float> deviceBuffer;
+
+    std::unique_ptr<SpscRingBuffer<float>> ringBuffer;
+    std::atomic<uint64_t> overrunCount{0};
+    std::atomic<uint64_t> droppedFrames{0};
+
+    size_t readDevice(float* buffer, size_t frames);
+    static int captureCallback(const void* input, void* output, unsigned long frameCount,
+                               const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags,
+                               void* userData);
+};
+
+// A sound file streamed through AudioFileReader, in any format and at any rate libsndfile supports.
+// 16 kHz mono 16-bit WAV files are memory-mapped and converted straight from the page cache instead.
+class WavFileSource : public AudioSource {
+public:
+    explicit WavFileSource(std::string path, Pacing pacing = Pacing::RealTime, ResamplerConfig resamplerConfig = {});
+    ~WavFileSource() override;
+
+    void start() override;
+    void stop() override;
+    size_t read(float* buffer, size_t frames) override;
+
+private:
+    std::string path;
+    ResamplerConfig resamplerConfig;
+    std::unique_ptr<AudioFileReader> reader;
+    std::unique_ptr<MappedWav> mapped;
+    size_t mappedPosition = 0;
+};
+
+enum class PcmFormat { S16LE, F32LE };
+
+// Raw headerless mono 16 kHz PCM from stdin or a named pipe / file.
+class PcmStreamSource : public AudioSource {
+public:
+    // An empty path or "-" reads stdin.
+    explicit PcmStreamSource(std::string path, PcmFormat format = PcmFormat::S16LE, Pacing pacing = Pacing::RealTime);
+    ~PcmStreamSource() override;
+
+    void start() override;
+    void stop() override;
+    size_t read(float* buffer, size_t frames) override;
+
+private:
+    std::string path;
+    PcmFormat format;
+    int fd = -1;
+    bool ownsFd = false;
+    std::vector<char> pending;
+};
+
+// Audio that is already decoded, such as the output of load_audio_data.
+class MemorySource : public AudioSource {
+public:
+    explicit MemorySource(std::vector<float> samples, Pacing pacing = Pacing::AsFastAsPossible)
+            : AudioSource(pacing), samples(std::move(samples)) {}
+
+    void start() override;
+    size_t read(float* buffer, size_t frames) override;
+
+private:
+    std::vector<float> samples;
+    size_t position = 0;
+};
+
+// Deterministic test signal: voiced bursts separated by low-level noise.
+class SyntheticSource : public AudioSource {
+public:
+    // durationSeconds <= 0 runs until stopped.
+    explicit SyntheticSource(float durationSeconds = 0.0f, float speechSeconds = 2.0f, float silenceSeconds = 1.5f,
+                             Pacing pacing = Pacing::RealTime);
+
+    void start() override;
+    size_t read(float* buffer, size_t frames) override;
+
+private:
+    uint64_t totalFrames;
+    uint64_t speechFrames;
+    uint64_t periodFrames;
+    uint64_t position = 0;
+    std::mt19937 generator;
+};
+
+#endif //AUDIO_SOURCE_H
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "batch.h"
+#include "pipeline.h"
+
+
+static const int SAMPLE_RATE = 16000;
+static constexpr auto CHUNK_POLL = std::chrono::milliseconds(100);
+static const std::vector<std::string> SOUND_EXTENSIONS = {
+        ".wav", ".flac", ".ogg", ".opus", ".mp3", ".aif", ".aiff", ".w64", ".caf", ".au"};
+
+
+static std::string segment_line(const std::string& file, const AudioChunk& chunk, const std::string& transcript,
+                                const std::string& translation) {
+    char times[64];
+    std::snprintf(times, sizeof(times), "\"start\": %.3f, \"end\": %.3f",
+                  static_cast<double>(chunk.start) / SAMPLE_RATE,
+                  static_cast<double>(chunk.start + chunk.samples.size()) / SAMPLE_RATE);
+    return "{\"file\": \"" + json_escape(file) + "\", " + times + ", \"transcript\": \"" + json_escape(transcript) +
+           "\", \"translation\": \"" + json_escape(translation) + "\"}\n";
+}
+
+static size_t worker_count(const BatchConfig& config, size_t jobs) {
+    size_t workers = config.workers > 0 ? config.workers : std::max(1u, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(workers, jobs));
+}
+
+
+BatchRunner::BatchRunner(BatchConfig config, RecorderFactory makeRecorder, const std::unique_ptr<Transcriber>& transcriber,
+                         const std::unique_ptr<Translator>& translator, const std::unique_ptr<Tokenizer>& tokenizer)
+        : config(config), makeRecorder(std::move(makeRecorder)), transcriber(transcriber), translator(translator),
+          tokenizer(tokenizer) {}
+
+BatchRunner::Result BatchRunner::run(const std::vector<std::string>& files, std::ostream& output,
+                                     const std::atomic<bool>& stop) {
+    const size_t workers = worker_count(config, files.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<size_t> done{0};
+
+    auto work = [&]() {
+        PriorityScope scope(config.priority);
+        while (!stop) {
+            size_t i = next++;
+            if (i >= files.size()) break;
+            std::string lines;
+            try {
+                lines = processFile(files[i]);
+            } catch (const std::exception& e) {
+                lines = "{\"file\": \"" + json_escape(files[i]) + "\", \"error\": \"" + json_escape(e.what()) + "\"}\n";
+                failed++;
+            }
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            output << lines << std::flush;
+            std::cerr << "[" << ++done << "/" << files.size() << "] " << files[i] << std::endl;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t w = 0; w < workers; ++w) pool.emplace_back(work);
+    for (auto& thread : pool) thread.join();
+
+    Result result;
+    result.failed = failed;
+    result.unprocessed = files.size() - done;
+    return result;
+}
+
+std::string BatchRunner::processFile(const std::string& path) {
+    std::unique_ptr<Recorder> recorder = makeRecorder(path);
+    recorder->start();
+
+    std::ostringstream lines;
+    while (true) {
+        // read before waiting: a recorder flags itself finished only after its last chunk is queued
+        bool finished = recorder->isFinished();
+        AudioChunk chunk = recorder->waitChunk(CHUNK_POLL);
+        if (chunk.empty()) {
+            if (finished) break;
+            continue;
+        }
+        if (!chunk.final) continue;
+
+        std::string transcript = transcribe(chunk.samples, transcriber);
+        std::string translation = translate(transcript, translator, tokenizer);
+
+        lines << segment_line(path, chunk, transcript, translation);
+    }
+
+    recorder->stop();
+    return lines.str();
+}
+
+
+SegmentRunner::SegmentRunner(BatchConfig config, const std::unique_ptr<Transcriber>& transcriber,
+                             const std::unique_ptr<Translator>& translator, const std::unique_ptr<Tokenizer>& tokenizer)
+        : config(config), transcriber(transcriber), translator(translator), tokenizer(tokenizer) {}
+
+size_t SegmentRunner::run(Recorder& recorder, const std::string& file, std::ostream& output) {
+    const size_t workers = worker_count(config, SIZE_MAX);
+    const size_t maxPending = 2 * workers;
+
+    pending.clear();
+    finished.clear();
+    segmentingDone = false;
+    nextToWrite = 0;
+
+    auto work = [&]() {
+        PriorityScope scope(config.priority);
+        while (true) {
+            std::pair<size_t, AudioChunk> segment;
+            {
+                std::unique_lock<std::mutex> lock(pendingMutex);
+                pendingChanged.wait(lock, [&]() { return !pending.empty() || segmentingDone; });
+                if (pending.empty()) return;
+                segment = std::move(pending.front());
+                pending.pop_front();
+            }
+            pendingChanged.notify_all();
+
+            std::string line;
+            try {
+                std::string transcript = transcribe(segment.second.samples, transcriber);
+                std::string translation = translate(transcript, translator, tokenizer);
+                line = segment_line(file, segment.second, transcript, translation);
+            } catch (const std::exception& e) {
+                // keep the order intact; one bad segment must not stall the ones after it
+                line = "{\"file\": \"" + json_escape(file) + "\", \"segment\": " + std::to_string(segment.first) +
+                       ", \"error\": \"" + json_escape(e.what()) + "\"}\n";
+            }
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            finished.emplace(segment.first, std::move(line));
+            for (auto it = finished.begin(); it != finished.end() && it->first == nextToWrite; it = finished.erase(it)) {
+                output << it->second;
+                nextToWrite++;
+            }
+            output << std::flush;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t w = 0; w < workers; ++w) pool.emplace_back(work);
+
+    // segmentation runs here, overlapping with the decoding of earlier segments
+    size_t segments = 0;
+    try {
+        recorder.start();
+        while (true) {
+            bool ended = recorder.isFinished();
+            AudioChunk chunk = recorder.waitChunk(CHUNK_POLL);
+            if (chunk.empty()) {
+                if (ended) break;
+                continue;
+            }
+            if (!chunk.final) continue;
+
+            std::unique_lock<std::mutex> lock(pendingMutex);
+            pendingChanged.wait(lock, [&]() { return pending.size() < maxPending; });
+            pending.emplace_back(segments++, std::move(chunk));
+            lock.unlock();
+            pendingChanged.notify_all();
+        }
+        recorder.stop();
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            pending.clear();
+            segmentingDone = true;
+        }
+        pendingChanged.notify_all();
+        for (auto& thread : pool) thread.join();
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        segmentingDone = true;
+    }
+    pendingChanged.notify_all();
+    for (auto& thread : pool) thread.join();
+
+    return segments;
+}
+
+
+static std::string lower_extension(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+std::vector<std::string> collect_batch_inputs(const std::string& spec) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> files;
+
+    if (fs::is_directory(spec)) {
+        for (const auto& entry : fs::recursive_directory_iterator(spec, fs::directory_options::skip_permission_denied)) {
+            if (!entry.is_regular_file()) continue;
+            const std::string extension = lower_extension(entry.path());
+            if (std::find(SOUND_EXTENSIONS.begin(), SOUND_EXTENSIONS.end(), extension) != SOUND_EXTENSIONS.end())
+                files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    const std::string extension = lower_extension(spec);
+    if (extension == ".txt" || extension == ".lst") {
+        std::ifstream list(spec);
+        if (!list.is_open()) {
+            throw std::runtime_error("Could not open file list: " + spec);
+        }
+        std::string line;
+        while (std::getline(list, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            files.push_back(line);
+        }
+        return files;
+    }
+
+    if (!fs::exists(spec)) {
+        throw std::runtime_error("No such batch input: " + spec);
+    }
+    files.push_back(spec);
+    return files;
+}
+
+std::string json_escape(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "models.h"
+#include "recorder.h"
+
+
+struct BatchConfig {
+    size_t workers = 0;     // 0: one per hardware thread
+    Priority priority = Priority::Batch;    // the workers' decodes yield to live streams sharing the models
+};
+
+// Transcribes many files concurrently, one JSON object per speech segment:
+// {"file": ..., "start": s, "end": s, "transcript": ..., "translation": ...}
+// Files that cannot be read produce {"file": ..., "error": ...} instead. Lines of one file stay together.
+class BatchRunner {
+public:
+    // Builds the recorder (source, detector, chunking) for one input file.
+    using RecorderFactory = std::function<std::unique_ptr<Recorder>(const std::string& path)>;
+
+    BatchRunner(BatchConfig config, RecorderFactory makeRecorder, const std::unique_ptr<Transcriber>& transcriber,
+                const std::unique_ptr<Translator>& translator, const std::unique_ptr<Tokenizer>& tokenizer);
+
+    struct Result {
+        size_t failed = 0;
+        size_t unprocessed = 0;     // never started because stop was set
+    };
+
+    // Once stop is set the workers finish the files they are on and take no new ones.
+    Result run(const std::vector<std::string>& files, std::ostream& output, const std::atomic<bool>& stop);
+
+private:
+    BatchConfig config;
+    RecorderFactory makeRecorder;
+    const std::unique_ptr<Transcriber>& transcriber;
+    const std::unique_ptr<Translator>& translator;
+    const std::unique_ptr<Tokenizer>& tokenizer;
+
+    std::mutex outputMutex;
+
+    std::string processFile(const std::string& path);
+};
+
+// Decodes the speech segments of one long recording in parallel: the recorder's VAD drops the silence, workers
+// transcribe and translate segments as they are found, and the lines are written in segment order, each one as
+// soon as every earlier segment is done. Uses the same line format as BatchRunner.
+class SegmentRunner {
+public:
+    SegmentRunner(BatchConfig config, const std::unique_ptr<Transcriber>& transcriber,
+                  const std::unique_ptr<Translator>& translator, const std::unique_ptr<Tokenizer>& tokenizer);
+
+    // The recorder must not be started yet. Returns the number of segments written.
+    size_t run(Recorder& recorder, const std::string& file, std::ostream& output);
+
+private:
+    BatchConfig config;
+    const std::unique_ptr<Transcriber>& transcriber;
+    const std::unique_ptr<Translator>& translator;
+    const std::unique_ptr<Tokenizer>& tokenizer;
+
+    // segments waiting for a worker, bounded so a fast VAD cannot buffer the whole file
+    std::mutex pendingMutex;
+    std::condition_variable pendingChanged;
+    std::deque<std::pair<size_t, AudioChunk>> pending;
+    bool segmentingDone = false;
+
+    // finished lines not yet written because an earlier segment is still being decoded
+    std::mutex outputMutex;
+    std::map<size_t, std::string> finished;
+    size_t nextToWrite = 0;
+};
+
+// A directory (searched recursively for sound files), a .txt/.lst file with one path per line, or one sound file.
+std::vector<std::string> collect_batch_inputs(const std::string& spec);
+
+std::string json_escape(const std::string& text);
+
+#endif //BATCH_H
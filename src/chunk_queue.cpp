@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "chunk_queue.h"
+
+
+ChunkQueue::ChunkQueue(size_t maxSamples, OverflowPolicy policy, size_t mergeLimitSamples)
+        : maxSamples(maxSamples), policy(policy), mergeLimitSamples(mergeLimitSamples) {
+    // self-pipe rather than eventfd so the notification fd also exists on macOS
+    if (pipe(notifyPipe) != 0) {
+        throw std::runtime_error("Could not create chunk notification pipe");
+    }
+    for (int fd : notifyPipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+}
+
+ChunkQueue::~ChunkQueue() {
+    ::close(notifyPipe[0]);
+    ::close(notifyPipe[1]);
+}
+
+void ChunkQueue::push(AudioChunk chunk) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!pendingPartial.empty() && pendingPartial.utterance == chunk.utterance) {
+            pendingPartial = AudioChunk();
+            updateSignal();
+        }
+
+        const size_t size = chunk.samples.size();
+        bool merged = false;
+
+        switch (policy) {
+            case OverflowPolicy::Block:
+                spaceAvailable.wait(lock, [&] {
+                    return closed || ringCount == 0 || queuedSamples + size <= maxSamples;
+                });
+                break;
+
+            case OverflowPolicy::DropNewest:
+                if (ringCount > 0 && queuedSamples + size > maxSamples) {
+                    droppedChunks++;
+                    droppedSamples += size;
+                    return;
+                }
+                break;
+
+            case OverflowPolicy::MergeShort:
+                if (ringCount > 0 && back().samples.size() + size <= mergeLimitSamples) {
+                    AudioChunk& last = back();
+                    last.samples.append(chunk.samples);
+                    last.utterance = chunk.utterance;
+                    last.closedAt = chunk.closedAt;
+                    queuedSamples += size;
+                    mergedChunks++;
+                    merged = true;
+                }
+                [[fallthrough]];
+
+            case OverflowPolicy::DropOldest:
+                // never drop the chunk that was just merged into
+                while (ringCount > (merged ? 1u : 0u) && queuedSamples + (merged ? 0 : size) > maxSamples) {
+                    dropFront();
+                }
+                break;
+        }
+
+        if (!merged) {
+            queuedSamples += size;
+            pushBack(std::move(chunk));
+            updateSignal();
+        }
+    }
+    chunkReady.notify_one();
+}
+
+void ChunkQueue::publishPartial(AudioChunk chunk) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingPartial = std::move(chunk);
+        updateSignal();
+    }
+    chunkReady.notify_one();
+}
+
+AudioChunk ChunkQueue::pop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return popLocked();
+}
+
+AudioChunk ChunkQueue::waitPop(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    chunkReady.wait_for(lock, timeout, [this] {
+        return ringCount > 0 || !pendingPartial.empty() || closed;
+    });
+    return popLocked();
+}
+
+void ChunkQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    chunkReady.notify_all();
+    spaceAvailable.notify_all();
+}
+
+void ChunkQueue::open() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = false;
+}
+
+ChunkQueueStats ChunkQueue::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    ChunkQueueStats result;
+    result.depth = ringCount;
+    result.queuedSamples = queuedSamples;
+    result.droppedChunks = droppedChunks;
+    result.droppedSamples = droppedSamples;
+    result.mergedChunks = mergedChunks;
+    return result;
+}
+
+void ChunkQueue::pushBack(AudioChunk chunk) {
+    if (ringCount == ring.size()) {
+        std::vector<AudioChunk> grown(std::max<size_t>(8, ring.size() * 2));
+        for (size_t i = 0; i < ringCount; ++i) grown[i] = std::move(ring[(ringHead + i) % ring.size()]);
+        ring = std::move(grown);
+        ringHead = 0;
+    }
+    ring[(ringHead + ringCount) % ring.size()] = std::move(chunk);
+    ringCount++;
+}
+
+AudioChunk ChunkQueue::popFront() {
+    AudioChunk chunk = std::move(front());
+    ringHead = (ringHead + 1) % ring.size();
+    ringCount--;
+    return chunk;
+}
+
+AudioChunk ChunkQueue::popLocked() {
+    AudioChunk chunk;
+    if (ringCount > 0) {
+        chunk = popFront();
+        queuedSamples -= chunk.samples.size();
+        updateSignal();
+        spaceAvailable.notify_all();
+    } else if (!pendingPartial.empty()) {
+        chunk = std::move(pendingPartial);
+        pendingPartial = AudioChunk();
+        updateSignal();
+    }
+    return chunk;
+}
+
+void ChunkQueue::dropFront() {
+    AudioChunk dropped = popFront();
+    droppedChunks++;
+    droppedSamples += dropped.samples.size();
+    queuedSamples -= dropped.samples.size();
+    updateSignal();
+}
+
+// Level-triggered: the pipe holds one byte while there is a chunk or a partial to take and none otherwise,
+// so the read end is readable exactly while there is something to take and can never fill up.
+void ChunkQueue::updateSignal() {
+    const bool available = ringCount > 0 || !pendingPartial.empty();
+    if (available == signalled) return;
+
+    char token = 1;
+    if (available) {
+        signalled = write(notifyPipe[1], &token, 1) == 1;
+    } else {
+        while (read(notifyPipe[0], &token, 1) == 1) {}
+        signalled = false;
+    }
+}
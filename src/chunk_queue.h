@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef CHUNK_QUEUE_H
+#define CHUNK_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "audio_buffer.h"
+
+
+struct AudioChunk {
+    AudioBuffer samples;
+    bool final = true;          // false: interim snapshot of an utterance that is still open
+    uint64_t utterance = 0;     // shared by the partials and the final chunk of one utterance
+    uint64_t start = 0;         // position of the first sample in the source, in 16 kHz frames
+    std::chrono::steady_clock::time_point closedAt{};  // when the recorder closed it, or took the snapshot
+
+    bool empty() const { return samples.empty(); }
+};
+
+// What push() does when the queued audio would exceed the budget.
+enum class OverflowPolicy {
+    DropOldest,     // discard queued chunks from the front until the new one fits
+    DropNewest,     // discard the incoming chunk
+    MergeShort,     // while the consumer is behind, append to the last queued chunk if both fit in one
+                    // merge window (fewer model runs for the same audio), then drop the oldest if still over;
+                    // a merged chunk keeps the start of its first part and the close time of its last
+    Block           // wait for the consumer; the capture side then counts overruns instead
+};
+
+struct ChunkQueueStats {
+    size_t depth = 0;
+    size_t queuedSamples = 0;
+    uint64_t droppedChunks = 0;
+    uint64_t droppedSamples = 0;
+    uint64_t mergedChunks = 0;
+};
+
+// Final chunks bounded by total queued samples, plus a single latest-wins slot for partials.
+// The partial of an utterance is discarded as soon as that utterance's final chunk is pushed.
+class ChunkQueue {
+public:
+    ChunkQueue(size_t maxSamples, OverflowPolicy policy, size_t mergeLimitSamples);
+    ~ChunkQueue();
+    ChunkQueue(const ChunkQueue&) = delete;
+    ChunkQueue& operator=(const ChunkQueue&) = delete;
+
+    void push(AudioChunk chunk);
+    void publishPartial(AudioChunk chunk);
+
+    // Final chunks come first. Both return an empty chunk when there is nothing to take.
+    AudioChunk pop();
+    AudioChunk waitPop(std::chrono::milliseconds timeout);
+
+    // Wakes all waiters and releases blocked producers; open() resets this for a new recording.
+    void close();
+    void open();
+
+    // Readable while pop() would return a chunk.
+    int eventFd() const { return notifyPipe[0]; }
+    ChunkQueueStats stats() const;
+
+private:
+    size_t maxSamples;
+    OverflowPolicy policy;
+    size_t mergeLimitSamples;
+
+    mutable std::mutex mutex;
+    std::condition_variable chunkReady;
+    std::condition_variable spaceAvailable;
+    // ring of queued chunks; it only grows, so steady-state pushes do not allocate
+    std::vector<AudioChunk> ring;
+    size_t ringHead = 0;
+    size_t ringCount = 0;
+    AudioChunk pendingPartial;
+    bool closed = false;
+    int notifyPipe[2] = {-1, -1};
+    bool signalled = false;     // the pipe holds its byte
+
+    size_t queuedSamples = 0;
+    uint64_t droppedChunks = 0;
+    uint64_t droppedSamples = 0;
+    uint64_t mergedChunks = 0;
+
+    AudioChunk& front() { return ring[ringHead]; }
+    AudioChunk& back() { return ring[(ringHead + ringCount - 1) % ring.size()]; }
+    void pushBack(AudioChunk chunk);
+    AudioChunk popFront();
+
+    AudioChunk popLocked();
+    void dropFront();
+    void updateSignal();
+};
+
+#endif //CHUNK_QUEUE_H
@@ -0,0 +1,76 @@
+#include <algorithm>
+
+#include "deadline_watchdog.h"
+
+
+DeadlineWatchdog::Watch::Watch(Watch&& other) noexcept
+        : watchdog(other.watchdog), id(other.id), fired(std::move(other.fired)) {
+    other.watchdog = nullptr;
+}
+
+DeadlineWatchdog::Watch::~Watch() {
+    if (watchdog) watchdog->unwatch(id);
+}
+
+DeadlineWatchdog::DeadlineWatchdog() : thread(&DeadlineWatchdog::loop, this) {}
+
+DeadlineWatchdog::~DeadlineWatchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    thread.join();
+}
+
+DeadlineWatchdog::Watch DeadlineWatchdog::watch(Ort::RunOptions& runOptions, Clock::time_point deadline) {
+    Watch watch;
+    if (deadline == Clock::time_point::max()) return watch;
+
+    watch.fired = std::make_shared<std::atomic<bool>>(false);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        watch.watchdog = this;
+        watch.id = nextId++;
+        entries.push_back({watch.id, &runOptions, deadline, watch.fired});
+    }
+    changed.notify_all();
+    return watch;
+}
+
+// Under the lock, so the watchdog never touches options whose call has already returned.
+void DeadlineWatchdog::unwatch(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [id](const Entry& entry) { return entry.id == id; }),
+                  entries.end());
+}
+
+void DeadlineWatchdog::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (entries.empty()) {
+            changed.wait(lock);
+            continue;
+        }
+
+        auto earliest = std::min_element(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.deadline < b.deadline;
+        })->deadline;
+        if (Clock::now() < earliest) {
+            changed.wait_until(lock, earliest);
+            continue;
+        }
+
+        const auto now = Clock::now();
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->deadline <= now) {
+                // flagged first: the terminated Run may throw before SetTerminate even returns
+                *it->fired = true;
+                it->runOptions->SetTerminate();
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
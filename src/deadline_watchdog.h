@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef CPP_DEMO_DEADLINE_WATCHDOG_H
+#define CPP_DEMO_DEADLINE_WATCHDOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "onnxruntime_cxx_api.h"
+
+
+// One thread that terminates ONNX Runtime calls whose deadline has passed. A watched call runs with its own
+// Ort::RunOptions; once the deadline is reached the watchdog sets its terminate flag and every Run on those
+// options, the one in flight included, throws Ort::Exception.
+class DeadlineWatchdog {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Watches the options until destroyed, so declare it after the RunOptions it watches.
+    class Watch {
+    public:
+        Watch() = default;
+        Watch(Watch&& other) noexcept;
+        Watch& operator=(Watch&&) = delete;
+        Watch(const Watch&) = delete;
+        ~Watch();
+
+        // True once the watchdog has terminated the options.
+        bool expired() const { return fired && *fired; }
+
+    private:
+        friend class DeadlineWatchdog;
+        DeadlineWatchdog* watchdog = nullptr;
+        uint64_t id = 0;
+        std::shared_ptr<std::atomic<bool>> fired;
+    };
+
+    DeadlineWatchdog();
+    ~DeadlineWatchdog();
+    DeadlineWatchdog(const DeadlineWatchdog&) = delete;
+    DeadlineWatchdog& operator=(const DeadlineWatchdog&) = delete;
+
+    // Clock::time_point::max() watches nothing.
+    Watch watch(Ort::RunOptions& runOptions, Clock::time_point deadline);
+
+private:
+    struct Entry {
+        uint64_t id;
+        Ort::RunOptions* runOptions;
+        Clock::time_point deadline;
+        std::shared_ptr<std::atomic<bool>> fired;
+    };
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<Entry> entries;
+    uint64_t nextId = 1;
+    bool stopping = false;
+    std::thread thread;
+
+    void unwatch(uint64_t id);
+    void loop();
+};
+
+#endif //CPP_DEMO_DEADLINE_WATCHDOG_H
@@ -1,107 +1,433 @@
+#include <cerrno>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
 #include <future>
+#include <mutex>
+#include <poll.h>
+#include <unistd.h>
 
 #include "whisper_process.h"
+#include "batch.h"
 #include "recorder.h"
+#include "runtime_context.h"
 #include "utils.h"
 #include "models.h"
+#include "options.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "sweep.h"
+#include "tuning.h"
+#include "vad.h"
+#include "warmup.h"
 
 
-struct ptr_wrapper{
-    std::unique_ptr<Translator> translation_ptr;
-    std::unique_ptr<Tokenizer> tokenizer_ptr;
-};
+std::unique_ptr<VoiceActivityDetector> load_voice_activity_detector(const AppOptions& options, const SessionTuning& tuning){
+    if (options.vad == "energy")
+        return std::make_unique<EnergyVad>();
+    if (options.vad == "adaptive")
+        return std::make_unique<AdaptiveEnergyVad>(options.vad_on_ratio, options.vad_off_ratio);
 
-std::unique_ptr<Transcriber> load_transcription_model(){
-    std::string root = std::filesystem::current_path().string();
-    const std::string transcriber_path = root + "/../whisper_onnx/model/whisper.onnx";
+    std::string model_path = options.vad_model_path;
+    if (model_path.empty())
+        model_path = std::filesystem::current_path().string() + "/../vad_onnx/model/silero_vad.onnx";
 
-    auto transcriber = std::make_unique<Transcriber>();
-    transcriber->load_model(transcriber_path);
-    std::cout << "whisper onnx model is loaded..."  << " ";
+    auto vad = std::make_unique<OnnxVad>(model_path, options.vad_threshold, tuning);
+    std::cout << "vad onnx model is loaded..."  << " ";
 
-    return transcriber;
+    return vad;
 }
 
-std::string transcribe(const std::vector<float>& audio_data, const std::unique_ptr<Transcriber>& transcriber){
-    Timer timer("whisper");
-    std::string root = std::filesystem::current_path().string();
-    const std::string python_preprocess_script = read_file_string(root + "/../whisper_onnx/scripts/process_script.py");
-    const std::string python_decode_script = read_file_string(root + "/../whisper_onnx/scripts/decode_script.py");
+// the file first, then --tune settings and --ort-threads on top
+TuningConfig load_tuning_config(const AppOptions& options){
+    TuningConfig tuning;
+    if (!options.tuning_file.empty())
+        tuning = load_tuning_file(options.tuning_file);
+    for (const auto& setting : options.tune) {
+        size_t eq = setting.find('=');
+        if (eq == std::string::npos)
+            throw std::invalid_argument("--tune takes <section>.<key>=<value>: " + setting);
+        set_tuning_value(tuning, setting.substr(0, eq), setting.substr(eq + 1));
+    }
+    if (options.ort_threads > 0)
+        tuning.runtime.intra_op_threads = options.ort_threads;
+    if (options.model_cache != "off")
+        tuning.runtime.model_cache_dir = options.model_cache;
+    tuning.runtime.batch_slots = static_cast<size_t>(options.batch_slots);
+    return tuning;
+}
 
-    std::vector<float> processed_audio_np = process_python_array(audio_data, python_preprocess_script);
+ResamplerConfig load_resampler_config(const AppOptions& options){
+    ResamplerConfig config;
+    if (options.resampler == "libsamplerate")
+        config.backend = ResamplerBackend::Libsamplerate;
+    if (options.resample_quality == "fast")
+        config.quality = ResampleQuality::Fast;
+    else if (options.resample_quality == "best")
+        config.quality = ResampleQuality::Best;
+    return config;
+}
+
+std::unique_ptr<AudioSource> load_audio_source(const std::string& source, const AppOptions& options){
+    Pacing pacing = options.pace == "fast" ? Pacing::AsFastAsPossible : Pacing::RealTime;
 
-    const std::vector<int64_t > token_ids = transcriber->infer(processed_audio_np);
-    std::string transcribed_sentence =  process_token_ids(token_ids, python_decode_script);
+    if (source == "mic")
+        return std::make_unique<PortAudioSource>(CaptureMode::Callback, 2.0f, load_resampler_config(options));
+    if (source.rfind("wav:", 0) == 0)
+        return std::make_unique<WavFileSource>(source.substr(4), pacing, load_resampler_config(options));
+    if (source == "pcm" || source.rfind("pcm:", 0) == 0) {
+        PcmFormat format = options.pcm_format == "f32le" ? PcmFormat::F32LE : PcmFormat::S16LE;
+        return std::make_unique<PcmStreamSource>(source == "pcm" ? "-" : source.substr(4), format, pacing);
+    }
+    float duration = source.size() > 10 ? std::stof(source.substr(10)) : 0.0f;
+    return std::make_unique<SyntheticSource>(duration, 2.0f, 1.5f, pacing);
+}
+
+// [<name>=]<source> for every input; a lone --source keeps the unlabelled output
+std::vector<std::string> stream_specs(const AppOptions& options){
+    if (options.streams.empty())
+        return {options.source};
+    return options.streams;
+}
+
+bool reads_stdin(const AppOptions& options){
+    for (const auto& spec : stream_specs(options)) {
+        const std::string source = split_stream_spec(spec).second;
+        if (source == "pcm" || source == "pcm:-")
+            return true;
+    }
+    return false;
+}
+
+RecorderConfig load_recorder_config(const AppOptions& options){
+    bool adaptive = options.vad == "adaptive";
+    int hangover_ms = options.hangover_ms.value_or(adaptive ? 400 : 1000);
+    int preroll_ms = options.preroll_ms.value_or(adaptive ? 192 : 0);
+
+    RecorderConfig config;
+    config.hangoverSeconds = static_cast<float>(hangover_ms) / 1000.0f;
+    config.prerollSeconds = static_cast<float>(preroll_ms) / 1000.0f;
+    config.maxChunkSeconds = static_cast<float>(options.max_chunk_ms) / 1000.0f;
+    config.splitSearchSeconds = static_cast<float>(options.split_search_ms) / 1000.0f;
+    config.splitOverlapSeconds = static_cast<float>(options.split_overlap_ms) / 1000.0f;
+    config.partialIntervalSeconds = static_cast<float>(options.partial_ms) / 1000.0f;
+    config.queueSeconds = static_cast<float>(options.queue_seconds);
+    if (options.overflow == "drop-newest")
+        config.overflowPolicy = OverflowPolicy::DropNewest;
+    else if (options.overflow == "merge")
+        config.overflowPolicy = OverflowPolicy::MergeShort;
+    else if (options.overflow == "block")
+        config.overflowPolicy = OverflowPolicy::Block;
+    return config;
+}
+size_t model_pool_size(const AppOptions& options){
+    if (options.model_pool > 0)
+        return static_cast<size_t>(options.model_pool);
+    // the live scheduler decodes on a single transcribe stage
+    if (options.batch.empty() && options.long_file.empty() && options.background.empty())
+        return 1;
+    size_t workers = options.workers > 0 ? static_cast<size_t>(options.workers)
+                                         : std::max(1u, std::thread::hardware_concurrency());
+    // background workers plus the live stage, which must never wait for a state
+    return options.background.empty() ? workers : workers + 1;
+}
 
-    return transcribed_sentence;
+// nothing is dropped and nobody reads partials offline
+RecorderConfig load_offline_recorder_config(const AppOptions& options){
+    RecorderConfig config = load_recorder_config(options);
+    config.overflowPolicy = OverflowPolicy::Block;
+    config.partialIntervalSeconds = 0.0f;
+    config.verbose = false;
+    return config;
 }
 
-ptr_wrapper load_translation_model(){
-    std::string root = std::filesystem::current_path().string();
-    std::string model_path = root + "/../transformer_onnx/model/No-En-Transformer.onnx";
+// spec is --batch or --background; once stop is set no further files are started
+int run_batch(const AppOptions& options, const std::string& spec, const TuningConfig& tuning,
+              const std::unique_ptr<Transcriber>& transcriber_ptr, const std::unique_ptr<Translator>& translation_ptr,
+              const std::unique_ptr<Tokenizer>& tokenizer_ptr, const std::atomic<bool>& stop){
+    std::vector<std::string> files = collect_batch_inputs(spec);
+    if (files.empty()) {
+        std::cerr << "No audio files found in " << spec << std::endl;
+        return 1;
+    }
+
+    RecorderConfig recorder_config = load_offline_recorder_config(options);
+    ResamplerConfig resampler_config = load_resampler_config(options);
 
-    auto tokenizer = std::make_unique<Tokenizer>("no", "en");
-    auto translator = std::make_unique<Translator>();
-    translator->load_model(model_path);
-    std::cout << "transformer onnx model is loaded..."  << std::endl;
+    auto make_recorder = [&](const std::string& path) {
+        return std::make_unique<Recorder>(recorder_config, load_voice_activity_detector(options, tuning.vad),
+                                          std::make_unique<WavFileSource>(path, Pacing::AsFastAsPossible, resampler_config));
+    };
+
+    std::ofstream output(options.batch_output);
+    if (!output) {
+        std::cerr << "Could not open " << options.batch_output << std::endl;
+        return 1;
+    }
 
-    return ptr_wrapper{std::move(translator), std::move(tokenizer)};
+    BatchConfig batch_config;
+    batch_config.workers = static_cast<size_t>(options.workers);
+    BatchRunner runner(batch_config, make_recorder, transcriber_ptr, translation_ptr, tokenizer_ptr);
+
+    auto started = std::chrono::steady_clock::now();
+    BatchRunner::Result result = runner.run(files, output, stop);
+    std::chrono::duration<float> took = std::chrono::steady_clock::now() - started;
+    std::cerr << files.size() - result.failed - result.unprocessed << " of " << files.size() << " files transcribed to "
+              << options.batch_output << " in " << took.count() << " s" << std::endl;
+    if (result.unprocessed > 0)
+        std::cerr << "Stopped with " << result.unprocessed << " files left unprocessed" << std::endl;
+    return result.failed == 0 && result.unprocessed == 0 ? 0 : 2;
 }
 
-std::string translate(const std::string& src_sentence,
-                      const std::unique_ptr<Translator>& translator,
-                      const std::unique_ptr<Tokenizer>& tokenizer){
-    Timer timer("transformer");
-    if (src_sentence == "<|nocaptions|>")
-        return "...";
+int run_long_file(const AppOptions& options, const TuningConfig& tuning, const std::unique_ptr<Transcriber>& transcriber_ptr,
+                  const std::unique_ptr<Translator>& translation_ptr, const std::unique_ptr<Tokenizer>& tokenizer_ptr){
+    auto started = std::chrono::steady_clock::now();
+    std::vector<float> audio_data = load_audio_data(options.long_file, load_resampler_config(options));
+    float audio_seconds = static_cast<float>(audio_data.size()) / 16000.0f;
+
+    Recorder recorder(load_offline_recorder_config(options), load_voice_activity_detector(options, tuning.vad),
+                      std::make_unique<MemorySource>(std::move(audio_data)));
+
+    std::ofstream output(options.batch_output);
+    if (!output) {
+        std::cerr << "Could not open " << options.batch_output << std::endl;
+        return 1;
+    }
 
-    std::string s = tokenizer->preprocessing(src_sentence);
-    std::vector<int64_t> encoder_input = tokenizer->convert_token_to_id(s);
-    std::vector<int> output = translator->infer(encoder_input);
-    std::string res = tokenizer->decode(output);
+    BatchConfig batch_config;
+    batch_config.workers = static_cast<size_t>(options.workers);
+    SegmentRunner runner(batch_config, transcriber_ptr, translation_ptr, tokenizer_ptr);
 
-    return res;
+    size_t segments = runner.run(recorder, options.long_file, output);
+    std::chrono::duration<float> took = std::chrono::steady_clock::now() - started;
+    std::cerr << segments << " segments of " << audio_seconds << " s audio transcribed to "
+              << options.batch_output << " in " << took.count() << " s" << std::endl;
+    return 0;
 }
 
 
-int main() {
-    PythonEnvironment py_env;
-    Recorder recorder;
+// Time-to-ready of each startup component, from construction; safe to call from the loading threads.
+class StartupLog {
+public:
+    void ready(const std::string& component) {
+        std::chrono::duration<float, std::milli> took = std::chrono::steady_clock::now() - started;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << component << " ready after " << static_cast<int>(took.count()) << " ms" << std::endl;
+    }
 
-    auto transcriber_ptr = load_transcription_model();
-    auto ptr_wraper = load_translation_model();
-    auto translation_ptr = std::move(ptr_wraper.translation_ptr);
-    auto tokenizer_ptr = std::move(ptr_wraper.tokenizer_ptr);
+private:
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    std::mutex mutex;
+};
 
-    std::atomic<bool> shouldExit(false);
+int main(int argc, char* argv[]) {
+    AppOptions options;
+    try {
+        options = parse_options(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    TuningConfig tuning;
+    try {
+        tuning = load_tuning_config(options);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // create the shared Env before any session, including each stream's neural VAD
+    RuntimeContext::instance(tuning.runtime);
 
-    std::thread inputThread([&shouldExit]() {
-        std::cin.get(); // Wait for Enter key
-        shouldExit = true;
+    if (!options.sweep.empty()) {
+        PythonEnvironment py_env;
+        try {
+            run_sweep(options.sweep, tuning, std::cout);
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    StartupLog startup;
+
+    // the models and vocabularies load on their own threads; Python stays on this one, since the thread that
+    // initialises the interpreter has to finalise it too
+    auto transcriber_future = std::async(std::launch::async, [&]() {
+        auto transcriber = load_transcription_model(tuning.whisper);
+        startup.ready("whisper");
+        return transcriber;
+    });
+    auto translation_future = std::async(std::launch::async, [&]() {
+        auto translator = load_translation_model(tuning.transformer);
+        startup.ready("transformer");
+        return translator;
     });
+    auto tokenizer_future = std::async(std::launch::async, [&]() {
+        auto tokenizer = load_tokenizer();
+        startup.ready("vocabularies");
+        return tokenizer;
+    });
+
+    PythonEnvironment py_env;
+    startup.ready("python");
 
-    recorder.start();
-
-    while (!shouldExit) {
-        auto chunk = recorder.getChunk();
-        if (!chunk.empty()) {
-            std::string src_sentence = transcribe(chunk, transcriber_ptr);
-            std::string trg_sentence = translate(src_sentence, translation_ptr, tokenizer_ptr);
-            if (!(trg_sentence.empty()))
-                std::cout << "******************************************" << "\n";
-                std::cout << trg_sentence << std::endl;
-                std::cout << "******************************************" << "\n";
-        }else{
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::unique_ptr<Transcriber> transcriber_ptr;
+    std::unique_ptr<Translator> translation_ptr;
+    std::unique_ptr<Tokenizer> tokenizer_ptr;
+    auto wait_for_models = [&]() {
+        try {
+            transcriber_ptr = transcriber_future.get();
+            translation_ptr = translation_future.get();
+            tokenizer_ptr = tokenizer_future.get();
+        } catch (const std::exception& e) {
+            std::cerr << "Startup failed: " << e.what() << std::endl;
+            return false;
+        }
+        startup.ready("models");
+
+        // the sessions are shared; the pool only sets how many threads may decode on them at once
+        size_t pool_size = model_pool_size(options);
+        transcriber_ptr->set_pool_size(pool_size);
+        translation_ptr->set_pool_size(pool_size);
+
+        if (options.warmup == "on") {
+            // the offline runners decode one chunk per call
+            size_t max_batch = options.batch.empty() && options.long_file.empty() ? static_cast<size_t>(options.max_batch) : 1;
+            try {
+                report_warmup(warm_up(transcriber_ptr, translation_ptr, tokenizer_ptr, max_batch), std::cout);
+            } catch (const std::exception& e) {
+                std::cerr << "Warm-up failed: " << e.what() << std::endl;
+                return false;
+            }
+            startup.ready("warm-up");
+        }
+        return true;
+    };
+
+    if (!options.batch.empty() || !options.long_file.empty()) {
+        if (!wait_for_models())
+            return 1;
+        try {
+            if (!options.batch.empty()) {
+                std::atomic<bool> stop(false);
+                return run_batch(options, options.batch, tuning, transcriber_ptr, translation_ptr, tokenizer_ptr, stop);
+            }
+            return run_long_file(options, tuning, transcriber_ptr, translation_ptr, tokenizer_ptr);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
         }
     }
 
-    recorder.stop();
+    SchedulerConfig scheduler_config;
+    scheduler_config.maxBatch = static_cast<size_t>(options.max_batch);
+    scheduler_config.batchWindow = std::chrono::milliseconds(options.batch_window_ms);
+    scheduler_config.deadline = std::chrono::milliseconds(options.deadline_ms);
+    if (options.stale == "skip")
+        scheduler_config.stalePolicy = StalePolicy::Skip;
+    // the model pointers are filled in once loaded; the scheduler only reads them in run()
+    StreamScheduler scheduler(scheduler_config, transcriber_ptr, translation_ptr, tokenizer_ptr);
 
-    inputThread.join();
+    const std::vector<std::string> specs = stream_specs(options);
+    for (size_t i = 0; i < specs.size(); ++i) {
+        auto [name, source] = split_stream_spec(specs[i]);
+        if (name.empty() && (!options.streams.empty() || !options.output_dir.empty()))
+            name = "s" + std::to_string(i + 1);
 
+        // every stream has its own detector state; only the models are shared
+        auto recorder = std::make_unique<Recorder>(load_recorder_config(options), load_voice_activity_detector(options, tuning.vad),
+                                                   load_audio_source(source, options));
+
+        std::unique_ptr<std::ostream> output;
+        if (!options.output_dir.empty()) {
+            std::filesystem::create_directories(options.output_dir);
+            std::string path = options.output_dir + "/" + name + ".txt";
+            output = std::make_unique<std::ofstream>(path, std::ios::app);
+            if (!*output) {
+                std::cerr << "Could not open " << path << std::endl;
+                return 1;
+            }
+            name.clear();
+        }
+        scheduler.addStream(name, std::move(recorder), std::move(output));
+    }
+
+    // capture starts now and the chunk queues hold the speech (up to --queue-seconds) until the models are up
+    scheduler.startCapture();
+    startup.ready("capture");
+    if (!wait_for_models())
+        return 1;
+
+    std::atomic<bool> shouldExit(false);
+    SessionScheduler& session_scheduler = RuntimeContext::instance().scheduler();
+
+    // file jobs on the capacity the live streams leave; their decodes yield to live ones between steps
+    std::thread backgroundThread;
+    if (!options.background.empty()) {
+        backgroundThread = std::thread([&]() {
+            try {
+                run_batch(options, options.background, tuning, transcriber_ptr, translation_ptr, tokenizer_ptr, shouldExit);
+            } catch (const std::runtime_error& e) {
+                std::cerr << e.what() << std::endl;
+            }
+        });
+    }
+
+    std::atomic<bool> statsDone(false);
+    std::thread statsThread;
+    if (options.stats_seconds > 0) {
+        statsThread = std::thread([&]() {
+            auto next = std::chrono::steady_clock::now() + std::chrono::seconds(options.stats_seconds);
+            while (!statsDone) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                if (std::chrono::steady_clock::now() < next) continue;
+                std::cerr << session_scheduler.describe() << std::endl;
+                next += std::chrono::seconds(options.stats_seconds);
+            }
+        });
+    }
+
+    // polls instead of blocking in std::cin, so it can be joined when a finite source ends before Enter
+    std::atomic<bool> inputDone(false);
+    std::thread inputThread;
+    if (!reads_stdin(options)) {
+        inputThread = std::thread([&shouldExit, &inputDone]() {
+            while (!shouldExit && !inputDone) {
+                pollfd input{STDIN_FILENO, POLLIN, 0};
+                int ready = poll(&input, 1, 100);
+                if (ready > 0) {
+                    std::cin.get(); // Enter, or end of input
+                    shouldExit = true;
+                } else if (ready < 0 && errno != EINTR) {
+                    break;
+                }
+            }
+        });
+    }
+
+    scheduler.run(shouldExit);
+
+    if (backgroundThread.joinable()) {
+        if (!shouldExit)
+            std::cerr << "Waiting for the background files to finish"
+                      << (inputThread.joinable() ? ", press Enter to stop" : "") << std::endl;
+        backgroundThread.join();
+    }
+    if (statsThread.joinable()) {
+        statsDone = true;
+        statsThread.join();
+    }
+    if (!options.background.empty() || options.stats_seconds > 0)
+        std::cerr << session_scheduler.describe() << std::endl;
+
+    if (inputThread.joinable()) {
+        inputDone = true;
+        inputThread.join();
+    }
 
 //    std::vector<float> audio_data_vector = load_audio_data("../demo1.wav");
 //    std::string src_sentence = transcribe(audio_data_vector, transcriber_ptr);
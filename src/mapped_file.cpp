@@ -0,0 +1,65 @@
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+
+MappedFile::MappedFile(const std::string& file_path) {
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file: " + file_path);
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat file: " + file_path);
+    }
+
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            address = nullptr;
+            length = 0;
+            close(fd);
+            throw std::runtime_error("Could not map file: " + file_path);
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+        : address(std::exchange(other.address, nullptr)), length(std::exchange(other.length, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        address = std::exchange(other.address, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+void MappedFile::advise_sequential() const {
+    // advisory only, a failure changes nothing but performance
+    if (address) madvise(address, length, MADV_SEQUENTIAL);
+}
+
+void MappedFile::unmap() {
+    if (address) {
+        munmap(address, length);
+        address = nullptr;
+        length = 0;
+    }
+}
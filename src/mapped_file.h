@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef CPP_DEMO_MAPPED_FILE_H
+#define CPP_DEMO_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+
+// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& file_path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return static_cast<const char*>(address); }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    // Hint that the mapping will be read front to back: more read-ahead, pages dropped early behind the reader.
+    void advise_sequential() const;
+
+private:
+    void* address = nullptr;
+    size_t length = 0;
+
+    void unmap();
+};
+
+#endif //CPP_DEMO_MAPPED_FILE_H
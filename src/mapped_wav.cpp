@@ -0,0 +1,78 @@
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#include "mapped_wav.h"
+
+
+static const int SAMPLE_RATE = 16000;
+static const uint16_t WAVE_FORMAT_PCM = 1;
+static const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+
+static uint16_t read_u16(const char* p) {
+    return static_cast<uint16_t>(static_cast<uint8_t>(p[0]) | (static_cast<uint8_t>(p[1]) << 8));
+}
+
+static uint32_t read_u32(const char* p) {
+    return static_cast<uint32_t>(read_u16(p)) | (static_cast<uint32_t>(read_u16(p + 2)) << 16);
+}
+
+std::unique_ptr<MappedWav> MappedWav::try_open(const std::string& file_path) {
+    // the samples are used in place, so their byte order must be the host's
+    if constexpr (std::endian::native != std::endian::little) return nullptr;
+
+    MappedFile file;
+    try {
+        file = MappedFile(file_path);
+    } catch (const std::runtime_error&) {
+        return nullptr;
+    }
+
+    const char* data = file.data();
+    const size_t size = file.size();
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) return nullptr;
+
+    bool format_ok = false;
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const char* chunk = data + offset;
+        uint32_t chunk_size = read_u32(chunk + 4);
+        size_t body = offset + 8;
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunk_size < 16 || body + 16 > size) return nullptr;
+            uint16_t format = read_u16(data + body);
+            uint16_t channels = read_u16(data + body + 2);
+            uint32_t sample_rate = read_u32(data + body + 4);
+            uint16_t bits = read_u16(data + body + 14);
+            if (format == WAVE_FORMAT_EXTENSIBLE && chunk_size >= 40 && body + 26 <= size) {
+                // the first two bytes of the sub-format GUID hold the actual format tag
+                format = read_u16(data + body + 24);
+            }
+            format_ok = format == WAVE_FORMAT_PCM && channels == 1 && sample_rate == SAMPLE_RATE && bits == 16;
+            if (!format_ok) return nullptr;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            // int16 access needs an even offset; the mapping itself is page aligned
+            if (!format_ok || body % alignof(int16_t) != 0) return nullptr;
+
+            // recorders that were killed mid-write leave a size of 0 or 0xFFFFFFFF; trust the file length then
+            size_t data_size = chunk_size == 0 || body + chunk_size > size ? size - body : chunk_size;
+            std::span<const int16_t> pcm(reinterpret_cast<const int16_t*>(data + body), data_size / sizeof(int16_t));
+
+            file.advise_sequential();
+            return std::unique_ptr<MappedWav>(new MappedWav(std::move(file), pcm));
+        }
+
+        // chunks are padded to an even length
+        offset = body + chunk_size + (chunk_size & 1u);
+    }
+    return nullptr;
+}
+
+void convert_pcm16(std::span<const int16_t> input, float* output) {
+    const float scale = 1.0f / 32768.0f;
+    for (size_t i = 0; i < input.size(); ++i) {
+        output[i] = static_cast<float>(input[i]) * scale;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef CPP_DEMO_MAPPED_WAV_H
+#define CPP_DEMO_MAPPED_WAV_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+#include "mapped_file.h"
+
+
+// Zero-copy view of a canonical 16 kHz mono 16-bit PCM WAV file, the format of our recording archives.
+// Anything else goes through AudioFileReader and libsndfile.
+class MappedWav {
+public:
+    // nullptr when the file cannot be mapped or is not in the fast-path format.
+    static std::unique_ptr<MappedWav> try_open(const std::string& file_path);
+
+    // The data chunk as it is on disk, little-endian int16.
+    std::span<const int16_t> samples() const { return pcm; }
+
+private:
+    MappedFile file;
+    std::span<const int16_t> pcm;
+
+    explicit MappedWav(MappedFile file, std::span<const int16_t> pcm) : file(std::move(file)), pcm(pcm) {}
+};
+
+// Scales int16 samples to float in [-1, 1); the loop vectorises.
+void convert_pcm16(std::span<const int16_t> input, float* output);
+
+#endif //CPP_DEMO_MAPPED_WAV_H
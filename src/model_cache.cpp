@@ -0,0 +1,143 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+#include "model_cache.h"
+#include "mapped_file.h"
+#include "tuning.h"
+
+
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Eight bytes per step, so hashing a few hundred megabytes of weights costs far less than optimising them.
+static uint64_t hash_bytes(const char* data, size_t size) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ size;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        h = mix(h ^ word) + i;
+    }
+    uint64_t tail = 0;
+    if (size > i) std::memcpy(&tail, data + i, size - i);
+    return mix(h ^ tail);
+}
+
+static uint64_t hash_string(const std::string& text) {
+    return hash_bytes(text.data(), text.size());
+}
+
+static const char* architecture() {
+#if defined(__x86_64__)
+    return "x86_64";
+#elif defined(__aarch64__) || defined(__arm64__)
+    return "arm64";
+#else
+    return "other";
+#endif
+}
+
+#ifdef __APPLE__
+static std::string sysctl_value(const char* name) {
+    size_t size = 0;
+    if (sysctlbyname(name, nullptr, &size, nullptr, 0) != 0 || size == 0) return "";
+    std::string value(size, '\0');
+    if (sysctlbyname(name, value.data(), &size, nullptr, 0) != 0) return "";
+    value.resize(size);
+    return value;
+}
+#endif
+
+// "" when the instruction set cannot be told
+static std::string cpu_flags() {
+#ifdef __APPLE__
+    // Intel Macs list their flags as strings; Apple silicon only has one switch per feature
+    std::string flags = sysctl_value("machdep.cpu.features") + " " + sysctl_value("machdep.cpu.leaf7_features");
+    for (const char* feature : {"hw.optional.neon", "hw.optional.arm.FEAT_FP16", "hw.optional.arm.FEAT_DotProd",
+                                "hw.optional.arm.FEAT_I8MM", "hw.optional.arm.FEAT_BF16", "hw.optional.arm.FEAT_SME"}) {
+        int enabled = 0;
+        size_t size = sizeof(enabled);
+        if (sysctlbyname(feature, &enabled, &size, nullptr, 0) == 0) flags += std::string(" ") + feature + "=" + std::to_string(enabled);
+    }
+    return flags.find_first_not_of(' ') == std::string::npos ? "" : flags;
+#else
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        // "flags" on x86, "Features" on ARM
+        if (line.rfind("flags", 0) == 0 || line.rfind("Features", 0) == 0) return line;
+    }
+    return "";
+#endif
+}
+
+static std::string hex(uint64_t value, int digits) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return std::string(text + 16 - digits);
+}
+
+// The model's content hash, kept in "<cache_dir>/<stem>-<path hash>.hash" with the size and mtime it was taken at, so a start
+// only reads the whole model again after it changed.
+static uint64_t model_hash(const std::string& cache_dir, const std::string& model_path) {
+    namespace fs = std::filesystem;
+    const uintmax_t size = fs::file_size(model_path);
+    const long long mtime = static_cast<long long>(fs::last_write_time(model_path).time_since_epoch().count());
+    const std::string sidecar = cache_dir + "/" + fs::path(model_path).stem().string() + "-" +
+                                hex(hash_string(fs::absolute(model_path).string()), 8) + ".hash";
+
+    std::ifstream known(sidecar);
+    uintmax_t known_size = 0;
+    long long known_mtime = 0;
+    std::string known_hash;
+    if (known >> known_size >> known_mtime >> known_hash && known_size == size && known_mtime == mtime &&
+        known_hash.size() == 16) {
+        char* end = nullptr;
+        const uint64_t hash = std::strtoull(known_hash.c_str(), &end, 16);
+        if (*end == '\0') return hash;
+    }
+
+    MappedFile model(model_path);
+    model.advise_sequential();
+    const uint64_t hash = hash_bytes(model.data(), model.size());
+
+    // same private-name-then-rename as the cached models; a failed write only costs a rehash next time
+    std::error_code error;
+    fs::create_directories(cache_dir, error);
+    const std::string partial = sidecar + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream out(partial, std::ios::trunc);
+        out << size << " " << mtime << " " << hex(hash, 16) << "\n";
+    }
+    fs::rename(partial, sidecar, error);
+    if (error) fs::remove(partial, error);
+    return hash;
+}
+
+std::string model_cache_path(const std::string& cache_dir, const std::string& model_path, const SessionTuning& tuning) {
+    static const std::string flags = cpu_flags();
+    if (flags.empty() && tuning.optimization == ORT_ENABLE_ALL) {
+        throw std::runtime_error("CPU features unknown; a graph optimised for this instruction set cannot be keyed");
+    }
+    static const std::string cpu = hex(hash_string(std::string(architecture()) + " " + flags), 8);
+    const std::string stem = std::filesystem::path(model_path).stem().string();
+
+    return cache_dir + "/" + stem + "-" + hex(model_hash(cache_dir, model_path), 16) + "-ort" +
+           Ort::GetVersionString() + "-" + optimization_name(tuning.optimization) + "-" +
+           (tuning.parallel_execution ? "parallel" : "sequential") + "-" + architecture() + "-cpu" + cpu + ".ort";
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#ifndef CPP_DEMO_MODEL_CACHE_H
+#define CPP_DEMO_MODEL_CACHE_H
+
+#include <string>
+
+#include "runtime_context.h"
+
+
+// Where the optimised ORT-format copy of model_path lives in cache_dir. The name changes with anything that can
+// change the optimised graph: the model's bytes, the ONNX Runtime version, the optimisation level, the execution
+// mode, the architecture and the CPU's feature flags (the "all" level picks layouts for the instruction set).
+// Thread and memory settings do not touch the graph, so they share an entry. The model is only rehashed when its
+// size or mtime changes. Throws std::runtime_error for the "all" level if the feature flags cannot be read.
+std::string model_cache_path(const std::string& cache_dir, const std::string& model_path, const SessionTuning& tuning);
+
+#endif //CPP_DEMO_MODEL_CACHE_H
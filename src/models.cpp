@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <array>
 #include <cstdio>
 #include <memory>
 #include <stdexcept>
@@ -18,8 +20,40 @@ const int64_t EOS = 2;
 const int64_t PAD = 0;
 
 
-void Translator::load_model(const std::string &model_path) {
-    session = Ort::Session(ort_env, model_path.c_str(), ort_session_options);
+void DecodeStatePool::resize(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idle.size() != states.size()) {
+        throw std::logic_error("Cannot resize a decode pool while it is in use");
+    }
+    states.clear();
+    idle.clear();
+    for (size_t i = 0; i < std::max<size_t>(1, size); ++i) {
+        states.push_back(std::make_unique<DecodeState>());
+        idle.push_back(states.back().get());
+    }
+}
+
+DecodeStatePool::Lease DecodeStatePool::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [&]() { return !idle.empty(); });
+    DecodeState* state = idle.back();
+    idle.pop_back();
+    return Lease(this, state);
+}
+
+void DecodeStatePool::release(DecodeState* state) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(state);
+    }
+    available.notify_one();
+}
+
+
+void Translator::load_model(const std::string &model_path, const SessionTuning& tuning) {
+    RuntimeContext& runtime = RuntimeContext::instance();
+    session = runtime.create_session(model_path, tuning);
+    scheduler = &runtime.scheduler();
     Ort::AllocatorWithDefaultOptions ort_alloc;
 
     size_t num_inputs = session.GetInputCount();
@@ -27,8 +61,6 @@ void Translator::load_model(const std::string &model_path) {
 
     input_names.reserve(num_inputs);
     output_names.reserve(num_outputs);
-    encoder_input_shapes.reserve(num_inputs);
-    decoder_input_shapes.reserve(num_outputs);
 
     for (size_t i = 0; i < num_inputs; i++) {
         Ort::AllocatedStringPtr input_temp = session.GetInputNameAllocated(i, ort_alloc);
@@ -43,17 +75,23 @@ void Translator::load_model(const std::string &model_path) {
     }
 }
 
-std::vector<int> Translator::infer(std::vector<int64_t>& encoder_input) {
+std::vector<int> Translator::infer(std::vector<int64_t>& encoder_input, const Ort::RunOptions* run_options) {
+    const Ort::RunOptions& options = run_options ? *run_options : runOptions;
     std::vector<int> output;
+    DecodeStatePool::Lease state = pool.acquire();
+    // after the lease: a batch decode held between steps keeps its state, so live work must not wait for one
+    SessionScheduler::Inference inference = scheduler->begin();
 
     auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
-    encoder_input_shapes = { 1, 128 };
-    decoder_input_shapes = { 1, 1 };
+    const std::array<int64_t, 2> encoder_input_shapes = { 1, 128 };
+    std::array<int64_t, 2> decoder_input_shapes = { 1, 1 };
 
-    std::vector<int64_t> decoder_input = { 1 };
+    std::vector<int64_t>& decoder_input = state->decoder_input;
+    decoder_input.assign(1, 1);
     int64_t output_length_counter = 1;
 
     while (true) {
+        std::vector<Ort::Value> input_tensors;
         input_tensors.emplace_back(
                 Ort::Value::CreateTensor<int64_t>(memory_info, encoder_input.data(),
                                                   encoder_input.size(), encoder_input_shapes.data(), encoder_input_shapes.size()));
@@ -61,7 +99,8 @@ std::vector<int> Translator::infer(std::vector<int64_t>& encoder_input) {
                 Ort::Value::CreateTensor<int64_t>(memory_info, decoder_input.data(),
                                                   decoder_input.size(), decoder_input_shapes.data(), decoder_input_shapes.size()));
 
-        std::vector<Ort::Value> output_tensors = session.Run(runOptions,
+        inference.step();
+        std::vector<Ort::Value> output_tensors = session.Run(options,
                                                              input_names.data(), input_tensors.data(), input_tensors.size(),
                                                              output_names.data(), output_names.size());
 
@@ -70,19 +109,16 @@ std::vector<int> Translator::infer(std::vector<int64_t>& encoder_input) {
         size_t total_elements = output_info.GetElementCount();
 
         auto output_data = output_tensor.GetTensorMutableData<float>();
-        std::vector<float> predict_token_vector(output_data + total_elements - TRANSFORMER_VOC_SIZE, output_data + total_elements);
+        std::vector<float>& predict_token_vector = state->logits;
+        predict_token_vector.assign(output_data + total_elements - TRANSFORMER_VOC_SIZE, output_data + total_elements);
         softmax(predict_token_vector);
         size_t next_token = argsort_max(predict_token_vector);
 
-        decoder_input_shapes.clear();
-        input_tensors.clear();
-
         if (next_token != TRANSFORMER_EOS) output.push_back(static_cast<int>(next_token));
 
         decoder_input.push_back(static_cast<int>(next_token));
         output_length_counter++;
-        decoder_input_shapes.push_back(1);
-        decoder_input_shapes.push_back(output_length_counter);
+        decoder_input_shapes[1] = output_length_counter;
 
         if ((next_token == TRANSFORMER_EOS) || (output_length_counter > MAX_LENGTH)) break;
     }
@@ -90,8 +126,36 @@ std::vector<int> Translator::infer(std::vector<int64_t>& encoder_input) {
     return output;
 }
 
-void Transcriber::load_model(const std::string &model_path) {
-    session = Ort::Session(ort_env, model_path.c_str(), ort_session_options);
+void Translator::warm_up() {
+    std::vector<DecodeStatePool::Lease> states;
+    for (size_t i = 0; i < pool.size(); ++i) {
+        states.push_back(pool.acquire());
+        states.back()->decoder_input.reserve(MAX_LENGTH + 1);
+        states.back()->logits.reserve(TRANSFORMER_VOC_SIZE);
+    }
+
+    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+    const std::array<int64_t, 2> encoder_input_shapes = { 1, MAX_LENGTH };
+    const std::array<int64_t, 2> decoder_input_shapes = { 1, MAX_LENGTH };
+    std::vector<int64_t> encoder_input(MAX_LENGTH, PAD);
+    encoder_input[0] = SOS;
+    std::vector<int64_t> decoder_input(MAX_LENGTH, SOS);
+
+    std::vector<Ort::Value> input_tensors;
+    input_tensors.emplace_back(
+            Ort::Value::CreateTensor<int64_t>(memory_info, encoder_input.data(),
+                                              encoder_input.size(), encoder_input_shapes.data(), encoder_input_shapes.size()));
+    input_tensors.emplace_back(
+            Ort::Value::CreateTensor<int64_t>(memory_info, decoder_input.data(),
+                                              decoder_input.size(), decoder_input_shapes.data(), decoder_input_shapes.size()));
+    session.Run(runOptions, input_names.data(), input_tensors.data(), input_tensors.size(),
+                output_names.data(), output_names.size());
+}
+
+void Transcriber::load_model(const std::string &model_path, const SessionTuning& tuning) {
+    RuntimeContext& runtime = RuntimeContext::instance();
+    session = runtime.create_session(model_path, tuning);
+    scheduler = &runtime.scheduler();
     Ort::AllocatorWithDefaultOptions ort_alloc;
 
     size_t num_inputs = session.GetInputCount();
@@ -99,8 +163,6 @@ void Transcriber::load_model(const std::string &model_path) {
 
     input_names.reserve(num_inputs);
     output_names.reserve(num_outputs);
-    encoder_input_shapes.reserve(num_inputs);
-    decoder_input_shapes.reserve(num_outputs);
 
     for (size_t i = 0; i < num_inputs; i++) {
         Ort::AllocatedStringPtr input_temp = session.GetInputNameAllocated(i, ort_alloc);
@@ -113,19 +175,41 @@ void Transcriber::load_model(const std::string &model_path) {
         output_names.emplace_back(output_temp.get());
         output_temp.release();
     }
+    // a symbolic leading dimension (-1) takes any batch size; a model exported with a fixed 1 does not
+    std::vector<int64_t> input_shape = session.GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+    batched = !input_shape.empty() && input_shape[0] == -1;
 }
 
-std::vector<int64_t> Transcriber::infer(std::vector<float>& encoder_input) {
+std::vector<int64_t> Transcriber::infer(std::vector<float>& encoder_input, const std::vector<int64_t>& forced_prefix,
+                                        const Ort::RunOptions* run_options) {
+    const Ort::RunOptions& options = run_options ? *run_options : runOptions;
     std::vector<int64_t> output;
+    DecodeStatePool::Lease state = pool.acquire();
+    SessionScheduler::Inference inference = scheduler->begin();
 
     auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
-    encoder_input_shapes = { 1, 80, 3000 };
-    decoder_input_shapes = { 1, 1 };
+    const std::array<int64_t, 3> encoder_input_shapes = { 1, 80, 3000 };
+    std::array<int64_t, 2> decoder_input_shapes = { 1, 1 };
 
-    std::vector<int64_t> decoder_input = { 1 };
+    std::vector<int64_t>& decoder_input = state->decoder_input;
+    decoder_input.assign(1, 1);
     int64_t output_length_counter = 1;
+    size_t forced_count = 0;
 
     while (true) {
+        if ((output_length_counter > WHISPER_PROMPT_TOKEN_NUM) && (forced_count < forced_prefix.size())) {
+            int64_t forced_token = forced_prefix[forced_count++];
+            output.push_back(forced_token);
+
+            decoder_input.push_back(forced_token);
+            output_length_counter++;
+            decoder_input_shapes[1] = output_length_counter;
+
+            if (output_length_counter > MAX_LENGTH) break;
+            continue;
+        }
+
+        std::vector<Ort::Value> input_tensors;
         input_tensors.emplace_back(
                 Ort::Value::CreateTensor<float>(memory_info, encoder_input.data(),
                                                   encoder_input.size(), encoder_input_shapes.data(), encoder_input_shapes.size()));
@@ -133,7 +217,8 @@ std::vector<int64_t> Transcriber::infer(std::vector<float>& encoder_input) {
                 Ort::Value::CreateTensor<int64_t>(memory_info, decoder_input.data(),
                                                   decoder_input.size(), decoder_input_shapes.data(), decoder_input_shapes.size()));
 
-        std::vector<Ort::Value> output_tensors = session.Run(runOptions,
+        inference.step();
+        std::vector<Ort::Value> output_tensors = session.Run(options,
                                                              input_names.data(), input_tensors.data(), input_tensors.size(),
                                                              output_names.data(), output_names.size());
 
@@ -142,25 +227,139 @@ std::vector<int64_t> Transcriber::infer(std::vector<float>& encoder_input) {
         size_t total_elements = output_info.GetElementCount();
 
         auto output_data = output_tensor.GetTensorMutableData<float>();
-        std::vector<float> predict_token_vector(output_data + total_elements - WHISPER_VOC_SIZE, output_data + total_elements);
+        std::vector<float>& predict_token_vector = state->logits;
+        predict_token_vector.assign(output_data + total_elements - WHISPER_VOC_SIZE, output_data + total_elements);
         softmax(predict_token_vector);
         size_t next_token = argsort_max(predict_token_vector);
 
-        decoder_input_shapes.clear();
-        input_tensors.clear();
-
         if ((next_token != WHISPER_EOS) && (output_length_counter > WHISPER_PROMPT_TOKEN_NUM))
             output.push_back(static_cast<int64_t>(next_token));
 
         decoder_input.push_back(static_cast<int>(next_token));
         output_length_counter++;
-        decoder_input_shapes.push_back(1);
-        decoder_input_shapes.push_back(output_length_counter);
+        decoder_input_shapes[1] = output_length_counter;
 
         if ((next_token == WHISPER_EOS) || (output_length_counter > MAX_LENGTH)) break;
     }
 
-    return std::move(output);
+    return output;
+}
+
+std::vector<std::vector<int64_t>> Transcriber::infer_batch(std::vector<std::vector<float>>& encoder_inputs,
+                                                           const std::vector<std::vector<int64_t>>& forced_prefixes,
+                                                           const Ort::RunOptions* run_options) {
+    const size_t batch = encoder_inputs.size();
+    if (batch == 1) {
+        return { infer(encoder_inputs[0], forced_prefixes.empty() ? std::vector<int64_t>() : forced_prefixes[0], run_options) };
+    }
+    const Ort::RunOptions& options = run_options ? *run_options : runOptions;
+
+    std::vector<std::vector<int64_t>> outputs(batch);
+    if (batch == 0) return outputs;
+    DecodeStatePool::Lease state = pool.acquire();
+    SessionScheduler::Inference inference = scheduler->begin();
+
+    std::vector<float>& encoder_batch = state->encoder_batch;
+    encoder_batch.clear();
+    encoder_batch.reserve(batch * encoder_inputs[0].size());
+    for (const auto& input : encoder_inputs) {
+        encoder_batch.insert(encoder_batch.end(), input.begin(), input.end());
+    }
+
+    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+    std::vector<int64_t> batch_encoder_shapes = { static_cast<int64_t>(batch), 80, 3000 };
+
+    // one row per input, all rows the same length; decoder_rows[r] is extended in place
+    std::vector<std::vector<int64_t>> decoder_rows(batch, std::vector<int64_t>{ 1 });
+    std::vector<size_t> forced_count(batch, 0);
+    std::vector<bool> finished(batch, false);
+    std::vector<int64_t>& decoder_input = state->decoder_input;
+    int64_t output_length_counter = 1;
+
+    auto forced_for = [&](size_t row) -> const std::vector<int64_t>* {
+        if (output_length_counter <= WHISPER_PROMPT_TOKEN_NUM || row >= forced_prefixes.size()) return nullptr;
+        if (forced_count[row] >= forced_prefixes[row].size()) return nullptr;
+        return &forced_prefixes[row];
+    };
+
+    while (true) {
+        bool needs_run = false;
+        for (size_t r = 0; r < batch; ++r) {
+            if (!finished[r] && !forced_for(r)) needs_run = true;
+        }
+
+        const float* output_data = nullptr;
+        std::vector<Ort::Value> output_tensors;
+        if (needs_run) {
+            decoder_input.clear();
+            for (const auto& row : decoder_rows) decoder_input.insert(decoder_input.end(), row.begin(), row.end());
+            std::vector<int64_t> batch_decoder_shapes = { static_cast<int64_t>(batch), output_length_counter };
+
+            std::vector<Ort::Value> batch_tensors;
+            batch_tensors.emplace_back(
+                    Ort::Value::CreateTensor<float>(memory_info, encoder_batch.data(), encoder_batch.size(),
+                                                    batch_encoder_shapes.data(), batch_encoder_shapes.size()));
+            batch_tensors.emplace_back(
+                    Ort::Value::CreateTensor<int64_t>(memory_info, decoder_input.data(), decoder_input.size(),
+                                                      batch_decoder_shapes.data(), batch_decoder_shapes.size()));
+
+            inference.step();
+            output_tensors = session.Run(options,
+                                         input_names.data(), batch_tensors.data(), batch_tensors.size(),
+                                         output_names.data(), output_names.size());
+            output_data = output_tensors[0].GetTensorMutableData<float>();
+        }
+
+        for (size_t r = 0; r < batch; ++r) {
+            int64_t next_token = WHISPER_EOS;
+            if (finished[r]) {
+                // padding only, the row's result is complete
+            } else if (const auto* forced = forced_for(r)) {
+                next_token = (*forced)[forced_count[r]++];
+                outputs[r].push_back(next_token);
+            } else {
+                // logits are [B, L, V]; the prediction for row r is its last position
+                const float* logits = output_data + ((r + 1) * output_length_counter - 1) * WHISPER_VOC_SIZE;
+                next_token = std::max_element(logits, logits + WHISPER_VOC_SIZE) - logits;
+                if (next_token == WHISPER_EOS) finished[r] = true;
+                else if (output_length_counter > WHISPER_PROMPT_TOKEN_NUM) outputs[r].push_back(next_token);
+            }
+            decoder_rows[r].push_back(next_token);
+        }
+        output_length_counter++;
+
+        bool all_finished = std::all_of(finished.begin(), finished.end(), [](bool f) { return f; });
+        if (all_finished || (output_length_counter > MAX_LENGTH)) break;
+    }
+
+    return outputs;
+}
+
+void Transcriber::warm_up(size_t batch) {
+    batch = std::max<size_t>(1, batch);
+    std::vector<DecodeStatePool::Lease> states;
+    for (size_t i = 0; i < pool.size(); ++i) {
+        states.push_back(pool.acquire());
+        states.back()->decoder_input.reserve(batch * (MAX_LENGTH + 1));
+        states.back()->logits.reserve(WHISPER_VOC_SIZE);
+        if (batch > 1) states.back()->encoder_batch.reserve(batch * 80 * 3000);
+    }
+
+    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+    const std::array<int64_t, 3> encoder_input_shapes = { static_cast<int64_t>(batch), 80, 3000 };
+    const std::array<int64_t, 2> decoder_input_shapes = { static_cast<int64_t>(batch), MAX_LENGTH };
+    std::vector<float> encoder_input(batch * 80 * 3000, 0.0f);
+    std::vector<int64_t> decoder_input(batch * MAX_LENGTH, 1);
+
+    std::vector<Ort::Value> input_tensors;
+    input_tensors.emplace_back(
+            Ort::Value::CreateTensor<float>(memory_info, encoder_input.data(),
+                                            encoder_input.size(), encoder_input_shapes.data(), encoder_input_shapes.size()));
+    input_tensors.emplace_back(
+            Ort::Value::CreateTensor<int64_t>(memory_info, decoder_input.data(),
+                                              decoder_input.size(), decoder_input_shapes.data(), decoder_input_shapes.size()));
+    session.Run(runOptions, input_names.data(), input_tensors.data(), input_tensors.size(),
+                output_names.data(), output_names.size());
 }
 
 Tokenizer::Tokenizer(const std::string& src, const std::string& trg) {
@@ -169,28 +368,13 @@ Tokenizer::Tokenizer(const std::string& src, const std::string& trg) {
     std::string src_voc_path = root + "/../transformer_onnx/voc/voc_" + src_lang + ".txt";
     std::string trg_voc_path = root + "/../transformer_onnx/voc/voc_" + trg_lang + ".txt";
 
-    //move to heap
-    trg_voc = std::make_unique<std::unordered_map<int, std::string>>(
-            std::get<std::unordered_map<int, std::string>>(load_vocab(trg_voc_path, false))
-    );
-    src_voc = std::make_unique<std::unordered_map<int, std::string>>(
-            std::get<std::unordered_map<int, std::string>>(load_vocab(src_voc_path, false))
-    );
-
-    reverse_trg_voc = std::make_unique<std::unordered_map<std::string, int>>(
-            std::get<std::unordered_map<std::string, int>>(load_vocab(trg_voc_path, true))
-    );
-
-    reverse_src_voc = std::make_unique<std::unordered_map<std::string, int>>(
-            std::get<std::unordered_map<std::string, int>>(load_vocab(src_voc_path, true))
-    );
+    src_voc = Vocab::load(src_voc_path);
+    trg_voc = Vocab::load(trg_voc_path);
 }
 
 Tokenizer::~Tokenizer() = default;
 
 std::string Tokenizer::preprocessing(const std::string& lines_to_translate) {
-    src_sentence = lines_to_translate;
-
     std::vector<std::string> command_normalize = {
             "perl", mosesdecoder_path + "/scripts/tokenizer/normalize-punctuation.perl", "-l", src_lang};
     std::vector<std::string> command_tokenize = {
@@ -255,7 +439,7 @@ std::vector<int64_t> Tokenizer::convert_token_to_id(const std::string& token_str
 
     std::vector<int64_t> token_ids = {SOS};
     for (const auto& token: tokens){
-        auto token_id =  static_cast<int64_t>(reverse_src_voc->at(token));
+        auto token_id =  static_cast<int64_t>(src_voc.id(token));
         token_ids.push_back(token_id);
     }
     token_ids.push_back(EOS);
@@ -272,7 +456,7 @@ std::vector<std::string> Tokenizer::convert_id_to_token(const std::vector<int>&
     std::vector<std::string> tokens;
     tokens.reserve(token_ids.size());
     for (const auto& e: token_ids)
-        tokens.emplace_back(trg_voc->at(e));
+        tokens.emplace_back(trg_voc.token(e));
 
     return tokens;
 }
@@ -303,12 +487,14 @@ std::string Tokenizer::postprocessing(const std::vector<std::string>& tokens){
     return translated_sentence;
 }
 
-std::string Tokenizer::decode(const std::vector<int> &token_ids) {
+std::string Tokenizer::decode(const std::vector<int> &token_ids, const std::string& src_sentence) {
     std::vector<std::string> tokens = convert_id_to_token(token_ids);
     std::string string = postprocessing(tokens);
 
-    char end_symbol = src_sentence[src_sentence.size() - 1];
-    string += end_symbol;
+    if (!src_sentence.empty()) {
+        char end_symbol = src_sentence[src_sentence.size() - 1];
+        string += end_symbol;
+    }
 
     return string;
 }
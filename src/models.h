@@ -3,56 +3,128 @@
 #ifndef CPP_DEMO_MODELS_H
 #define CPP_DEMO_MODELS_H
 
+#include <condition_variable>
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 
 #include "onnxruntime_cxx_api.h"
+#include "runtime_context.h"
 #include "utils.h"
+#include "vocab.h"
 
-class Transcriber {
+// Scratch buffers of one inference in flight, kept between calls so a worker does not reallocate them per chunk.
+struct DecodeState {
+    std::vector<int64_t> decoder_input;
+    std::vector<float> logits;
+    std::vector<float> encoder_batch;
+};
+
+// The decode states of one model. Every state runs on the model's single Ort::Session, which is safe to Run
+// from several threads at once, so the weights are loaded once however large the pool is. acquire() blocks
+// while all states are in use, which bounds how many inferences share the CPU.
+class DecodeStatePool {
 public:
-    Transcriber(): ort_env(), runOptions(Ort::RunOptions()){};
+    class Lease {
+    public:
+        Lease(DecodeStatePool* pool, DecodeState* state) : pool(pool), state(state) {}
+        Lease(Lease&& other) noexcept : pool(other.pool), state(other.state) { other.state = nullptr; }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { if (state) pool->release(state); }
+
+        DecodeState& operator*() const { return *state; }
+        DecodeState* operator->() const { return state; }
+
+    private:
+        DecodeStatePool* pool;
+        DecodeState* state;
+    };
+
+    explicit DecodeStatePool(size_t size = 1) { resize(size); }
+
+    // Only while no state is leased out.
+    void resize(size_t size);
+    size_t size() const { return states.size(); }
+    Lease acquire();
+
+private:
+    std::mutex mutex;
+    std::condition_variable available;
+    std::vector<std::unique_ptr<DecodeState>> states;
+    std::vector<DecodeState*> idle;
 
-    void load_model(const std::string& model_path);
-    std::vector<int64_t> infer(std::vector<float>& encoder_input);
+    void release(DecodeState* state);
+};
+
+// infer and infer_batch keep all per-call state on the stack or in a leased DecodeState,
+// so any number of threads may call them on one instance. Every decode step goes through the
+// RuntimeContext's SessionScheduler in the calling thread's priority class.
+class Transcriber {
+public:
+    Transcriber(): runOptions(Ort::RunOptions()){};
+
+    // The session runs on the process-wide RuntimeContext.
+    void load_model(const std::string& model_path, const SessionTuning& tuning = {});
+    // How many inferences may run at once; call before the first one.
+    void set_pool_size(size_t size) { pool.resize(size); }
+    size_t pool_size() const { return pool.size(); }
+
+    // forced_prefix: text tokens appended after the prompt without running the decoder,
+    // e.g. the stable part of the previous partial result for the same utterance.
+    // run_options: this call's own options, so another thread can SetTerminate() it; the decode then throws
+    // Ort::Exception at its current step.
+    std::vector<int64_t> infer(std::vector<float>& encoder_input, const std::vector<int64_t>& forced_prefix = {},
+                               const Ort::RunOptions* run_options = nullptr);
+    // Whether the model was exported with a dynamic batch dimension, read from its input at load time.
+    bool supports_batch() const { return batched; }
+    // Decodes several log-mel inputs in one [B, 80, 3000] run per step. Rows that reach EOS are padded
+    // with EOS until the longest row finishes. Needs supports_batch().
+    std::vector<std::vector<int64_t>> infer_batch(std::vector<std::vector<float>>& encoder_inputs,
+                                                  const std::vector<std::vector<int64_t>>& forced_prefixes = {},
+                                                  const Ort::RunOptions* run_options = nullptr);
+    // One run at the longest decoder input a decode can reach, for batch inputs at once, so ONNX Runtime
+    // allocates its arena and kernels for the peak shape before the first real chunk; also grows every pooled
+    // state's buffers to their final size. Call before the first inference.
+    void warm_up(size_t batch = 1);
 
 private:
-    Ort::Env ort_env;
     Ort::RunOptions runOptions;
     Ort::Session session{nullptr};
-    Ort::SessionOptions ort_session_options;
+    SessionScheduler* scheduler = nullptr;
+    bool batched = false;
 
     std::unordered_map<int, std::string> voc_src;
 
     std::vector<const char*> input_names;
     std::vector<const char*> output_names;
 
-    std::vector<int64_t> encoder_input_shapes;
-    std::vector<int64_t> decoder_input_shapes;
-
-    std::vector<Ort::Value> input_tensors;
+    DecodeStatePool pool;
 };
 
+// Re-entrant in the same way as Transcriber.
 class Translator {
 public:
-    Translator():ort_env(), runOptions(Ort::RunOptions()){};
+    Translator(): runOptions(Ort::RunOptions()){};
 
-    void load_model(const std::string& model_path);
-    std::vector<int> infer(std::vector<int64_t>& encoder_input);
+    void load_model(const std::string& model_path, const SessionTuning& tuning = {});
+    void set_pool_size(size_t size) { pool.resize(size); }
+    size_t pool_size() const { return pool.size(); }
+
+    std::vector<int> infer(std::vector<int64_t>& encoder_input, const Ort::RunOptions* run_options = nullptr);
+    // Same as Transcriber::warm_up, for a single sentence.
+    void warm_up();
 
 private:
-    Ort::Env ort_env;
     Ort::RunOptions runOptions;
     Ort::Session session{nullptr};
-    Ort::SessionOptions ort_session_options;
+    SessionScheduler* scheduler = nullptr;
 
     std::vector<const char*> input_names;
     std::vector<const char*> output_names;
 
-    std::vector<int64_t> encoder_input_shapes;
-    std::vector<int64_t> decoder_input_shapes;
-
-    std::vector<Ort::Value> input_tensors;
+    DecodeStatePool pool;
 };
 
 class Tokenizer{
@@ -60,8 +132,6 @@ public:
     std::string src_lang;
     std::string trg_lang;
 
-    std::string src_sentence;
-
     Tokenizer(const std::string& src, const std::string& trg);
     ~Tokenizer();
 
@@ -70,7 +140,8 @@ public:
     std::vector<std::string> convert_id_to_token(const std::vector<int>& token_ids);
     std::string postprocessing(const std::vector<std::string>& tokens);
 
-    std::string decode(const std::vector<int>& token_ids);
+    // src_sentence is the untokenized input; its final punctuation mark is carried over.
+    std::string decode(const std::vector<int>& token_ids, const std::string& src_sentence);
 
 private:
     std::string root = std::filesystem::current_path().string();
@@ -78,11 +149,8 @@ private:
     std::string mosesdecoder_path = root + "/../transformer_onnx/tokenize_tool/mosesdecoder";
     std::string vocab_path = root + "/../transformer_onnx/voc";
 
-    std::unique_ptr<std::unordered_map<int, std::string>> src_voc;
-    std::unique_ptr<std::unordered_map<int, std::string>> trg_voc;
-
-    std::unique_ptr<std::unordered_map<std::string, int>> reverse_src_voc;
-    std::unique_ptr<std::unordered_map<std::string, int>> reverse_trg_voc;
+    Vocab src_voc;
+    Vocab trg_voc;
 
     static std::string run_script(const std::vector<std::string>& script, const std::string& strings);
 };
@@ -0,0 +1,286 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include "options.h"
+
+
+static float parse_float(const std::string& name, const std::string& value) {
+    try {
+        size_t used = 0;
+        float result = std::stof(value, &used);
+        if (used == value.size()) return result;
+    } catch (const std::logic_error&) {}
+    throw std::invalid_argument("Invalid value for --" + name + ": " + value);
+}
+
+static int parse_int(const std::string& name, const std::string& value) {
+    try {
+        size_t used = 0;
+        int result = std::stoi(value, &used);
+        if (used == value.size()) return result;
+    } catch (const std::logic_error&) {}
+    throw std::invalid_argument("Invalid value for --" + name + ": " + value);
+}
+
+static bool is_source_spec(const std::string& value) {
+    return value == "mic" || value == "pcm" || value == "synthetic" ||
+           value.rfind("wav:", 0) == 0 || value.rfind("pcm:", 0) == 0 || value.rfind("synthetic:", 0) == 0;
+}
+
+static void check_source_spec(const std::string& name, const std::string& value) {
+    if (!is_source_spec(value)) {
+        throw std::invalid_argument("Unknown audio source: " + value);
+    }
+    if (value.rfind("synthetic:", 0) == 0) parse_float(name, value.substr(10));
+}
+
+std::pair<std::string, std::string> split_stream_spec(const std::string& spec) {
+    // a name cannot contain ':', so "wav:a=b.wav" is still a bare source
+    size_t eq = spec.find('=');
+    if (eq == std::string::npos || spec.find(':') < eq) return {"", spec};
+    return {spec.substr(0, eq), spec.substr(eq + 1)};
+}
+
+AppOptions parse_options(int argc, char* argv[]) {
+    AppOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            std::exit(0);
+        }
+        if (arg.rfind("--", 0) != 0) {
+            throw std::invalid_argument("Unexpected argument: " + arg);
+        }
+
+        std::string name = arg.substr(2);
+        std::string value;
+        size_t eq = name.find('=');
+        if (eq != std::string::npos) {
+            value = name.substr(eq + 1);
+            name = name.substr(0, eq);
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            throw std::invalid_argument("Missing value for --" + name);
+        }
+
+        if (name == "source") {
+            check_source_spec(name, value);
+            options.source = value;
+        } else if (name == "pcm-format") {
+            if (value != "s16le" && value != "f32le") {
+                throw std::invalid_argument("Unknown PCM format: " + value);
+            }
+            options.pcm_format = value;
+        } else if (name == "pace") {
+            if (value != "realtime" && value != "fast") {
+                throw std::invalid_argument("Unknown pacing: " + value);
+            }
+            options.pace = value;
+        } else if (name == "resampler") {
+            if (value != "polyphase" && value != "libsamplerate") {
+                throw std::invalid_argument("Unknown resampler: " + value);
+            }
+            options.resampler = value;
+        } else if (name == "resample-quality") {
+            if (value != "fast" && value != "medium" && value != "best") {
+                throw std::invalid_argument("Unknown resample quality: " + value);
+            }
+            options.resample_quality = value;
+        } else if (name == "vad") {
+            if (value != "energy" && value != "adaptive" && value != "neural") {
+                throw std::invalid_argument("Unknown VAD type: " + value);
+            }
+            options.vad = value;
+        } else if (name == "vad-model") {
+            options.vad_model_path = value;
+        } else if (name == "vad-threshold") {
+            options.vad_threshold = parse_float(name, value);
+        } else if (name == "vad-on-ratio") {
+            options.vad_on_ratio = parse_float(name, value);
+        } else if (name == "vad-off-ratio") {
+            options.vad_off_ratio = parse_float(name, value);
+        } else if (name == "hangover-ms") {
+            options.hangover_ms = parse_int(name, value);
+            if (*options.hangover_ms < 0) {
+                throw std::invalid_argument("--hangover-ms cannot be negative");
+            }
+        } else if (name == "preroll-ms") {
+            options.preroll_ms = parse_int(name, value);
+            if (*options.preroll_ms < 0) {
+                throw std::invalid_argument("--preroll-ms cannot be negative");
+            }
+        } else if (name == "max-chunk-ms") {
+            options.max_chunk_ms = parse_int(name, value);
+            if (options.max_chunk_ms < 0) {
+                throw std::invalid_argument("--max-chunk-ms cannot be negative");
+            }
+        } else if (name == "split-search-ms") {
+            options.split_search_ms = parse_int(name, value);
+            if (options.split_search_ms < 0) {
+                throw std::invalid_argument("--split-search-ms cannot be negative");
+            }
+        } else if (name == "split-overlap-ms") {
+            options.split_overlap_ms = parse_int(name, value);
+            if (options.split_overlap_ms < 0) {
+                throw std::invalid_argument("--split-overlap-ms cannot be negative");
+            }
+        } else if (name == "queue-seconds") {
+            options.queue_seconds = parse_int(name, value);
+            if (options.queue_seconds < 0) {
+                throw std::invalid_argument("--queue-seconds cannot be negative");
+            }
+        } else if (name == "overflow") {
+            if (value != "drop-oldest" && value != "drop-newest" && value != "merge" && value != "block") {
+                throw std::invalid_argument("Unknown overflow policy: " + value);
+            }
+            options.overflow = value;
+        } else if (name == "partial-ms") {
+            options.partial_ms = parse_int(name, value);
+            if (options.partial_ms < 0) {
+                throw std::invalid_argument("--partial-ms cannot be negative");
+            }
+        } else if (name == "stream") {
+            auto [stream_name, source] = split_stream_spec(value);
+            check_source_spec(name, source);
+            if (stream_name.find_first_of("/[]") != std::string::npos) {
+                throw std::invalid_argument("Invalid stream name: " + stream_name);
+            }
+            options.streams.push_back(value);
+        } else if (name == "output-dir") {
+            options.output_dir = value;
+        } else if (name == "max-batch") {
+            options.max_batch = parse_int(name, value);
+            if (options.max_batch < 1) {
+                throw std::invalid_argument("--max-batch must be at least 1");
+            }
+        } else if (name == "batch-window-ms") {
+            options.batch_window_ms = parse_int(name, value);
+            if (options.batch_window_ms < 0) {
+                throw std::invalid_argument("--batch-window-ms cannot be negative");
+            }
+        } else if (name == "deadline-ms") {
+            options.deadline_ms = parse_int(name, value);
+            if (options.deadline_ms < 0) {
+                throw std::invalid_argument("--deadline-ms cannot be negative");
+            }
+        } else if (name == "stale") {
+            if (value != "skip" && value != "merge") {
+                throw std::invalid_argument("Unknown stale chunk policy: " + value);
+            }
+            options.stale = value;
+        } else if (name == "batch") {
+            options.batch = value;
+        } else if (name == "long-file") {
+            options.long_file = value;
+        } else if (name == "background") {
+            options.background = value;
+        } else if (name == "batch-output") {
+            options.batch_output = value;
+        } else if (name == "workers") {
+            options.workers = parse_int(name, value);
+            if (options.workers < 0) {
+                throw std::invalid_argument("--workers cannot be negative");
+            }
+        } else if (name == "model-pool") {
+            options.model_pool = parse_int(name, value);
+            if (options.model_pool < 0) {
+                throw std::invalid_argument("--model-pool cannot be negative");
+            }
+        } else if (name == "batch-slots") {
+            options.batch_slots = parse_int(name, value);
+            if (options.batch_slots < 0) {
+                throw std::invalid_argument("--batch-slots cannot be negative");
+            }
+        } else if (name == "stats-seconds") {
+            options.stats_seconds = parse_int(name, value);
+            if (options.stats_seconds < 0) {
+                throw std::invalid_argument("--stats-seconds cannot be negative");
+            }
+        } else if (name == "ort-threads") {
+            options.ort_threads = parse_int(name, value);
+            if (options.ort_threads < 0) {
+                throw std::invalid_argument("--ort-threads cannot be negative");
+            }
+        } else if (name == "tuning") {
+            options.tuning_file = value;
+        } else if (name == "tune") {
+            options.tune.push_back(value);
+        } else if (name == "model-cache") {
+            options.model_cache = value;
+        } else if (name == "sweep") {
+            options.sweep = value;
+        } else if (name == "warmup") {
+            if (value != "on" && value != "off") {
+                throw std::invalid_argument("--warmup is on or off: " + value);
+            }
+            options.warmup = value;
+        } else {
+            throw std::invalid_argument("Unknown option: --" + name);
+        }
+    }
+
+    int stdin_streams = 0;
+    for (const auto& spec : options.streams) {
+        const std::string source = split_stream_spec(spec).second;
+        if (source == "pcm" || source == "pcm:-") stdin_streams++;
+    }
+    if (stdin_streams > 1) {
+        throw std::invalid_argument("Only one stream can read stdin");
+    }
+    if (!options.batch.empty() && !options.long_file.empty()) {
+        throw std::invalid_argument("--batch and --long-file cannot be combined");
+    }
+    if (!options.background.empty() && (!options.batch.empty() || !options.long_file.empty())) {
+        throw std::invalid_argument("--background runs beside the live streams, not with --batch or --long-file");
+    }
+
+    return options;
+}
+
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --source <spec>           mic | wav:<path> | pcm[:<path>] (stdin by default) | synthetic[:<seconds>] (default: mic)\n"
+              << "  --pcm-format <fmt>        s16le|f32le mono 16 kHz for pcm sources (default: s16le)\n"
+              << "  --pace realtime|fast      deliver file/pipe/synthetic audio at capture speed or as fast as possible (default: realtime)\n"
+              << "  --resampler <backend>     polyphase|libsamplerate for input that is not 16 kHz (default: polyphase)\n"
+              << "  --resample-quality <q>    fast|medium|best (default: medium)\n"
+              << "  --vad energy|adaptive|neural  voice activity detector (default: energy)\n"
+              << "  --vad-model <path>        ONNX model for the neural detector\n"
+              << "  --vad-threshold <p>       speech probability threshold for the neural detector (default: 0.5)\n"
+              << "  --vad-on-ratio <r>        adaptive detector onset over the noise floor (default: 4)\n"
+              << "  --vad-off-ratio <r>       adaptive detector release over the noise floor (default: 2)\n"
+              << "  --hangover-ms <ms>        silence that closes a chunk (default: 1000, adaptive: 400)\n"
+              << "  --preroll-ms <ms>         audio kept from before speech onset (default: 0, adaptive: 192)\n"
+              << "  --max-chunk-ms <ms>       split speech longer than this, 0 disables (default: 30000)\n"
+              << "  --split-search-ms <ms>    look this far back from the limit for a quiet split point (default: 2000)\n"
+              << "  --split-overlap-ms <ms>   audio repeated at the start of the next chunk after a split (default: 500)\n"
+              << "  --queue-seconds <s>       audio budget for chunks waiting to be transcribed (default: 120)\n"
+              << "  --overflow <policy>       drop-oldest|drop-newest|merge|block when over budget (default: drop-oldest)\n"
+              << "  --partial-ms <ms>         print an interim transcript this often during speech, 0 disables (default: 0)\n"
+              << "  --stream [<name>=]<source>  add an input stream, repeatable; replaces --source (default name: s1, s2, ...)\n"
+              << "  --output-dir <dir>        write each stream to <dir>/<name>.txt instead of labelled stdout\n"
+              << "  --max-batch <n>           chunks from different streams decoded together (default: 4)\n"
+              << "  --batch-window-ms <ms>    how long a ready chunk waits for other streams to join its batch (default: 20)\n"
+              << "  --deadline-ms <ms>        give up on chunks not decoded this long after they were spoken, 0: never (default: 0)\n"
+              << "  --stale <policy>          skip | merge: chunks already past the deadline when taken (default: merge)\n"
+              << "  --batch <path>            transcribe a directory, a .txt/.lst file list or one file as fast as possible, then exit\n"
+              << "  --long-file <path>        transcribe one long recording, decoding its speech segments in parallel, then exit\n"
+              << "  --background <spec>       like --batch, but while the live streams run; live decodes preempt it between steps;\n"
+              << "                            Enter stops it after the files in progress\n"
+              << "  --batch-output <path>     JSON lines written by --batch, --long-file or --background, one per speech segment (default: transcripts.jsonl)\n"
+              << "  --workers <n>             files or segments processed at once, 0: one per hardware thread (default: 0)\n"
+              << "  --model-pool <n>          inferences run at once on each shared model (default: --workers in batch modes, else 1)\n"
+              << "  --batch-slots <n>         batch-priority decode steps in flight at once while live work is idle, 0: no limit (default: 0)\n"
+              << "  --stats-seconds <s>       print queue depth and wait times per priority class this often, 0: at exit only (default: 0)\n"
+              << "  --ort-threads <n>         intra-op threads shared by all models, 0: one per core (default: 0)\n"
+              << "  --tuning <file>           ONNX Runtime session settings per model: [runtime], [whisper], [transformer], [vad]\n"
+              << "  --tune <section.key=val>  one session setting, repeatable, over the file, e.g. whisper.intra_op_threads=16\n"
+              << "                            keys: intra_op_threads inter_op_threads execution_mode optimization mem_pattern cpu_arena affinity\n"
+              << "  --model-cache <dir|off>   keep optimised models here to skip graph optimisation on later starts (default: ../model_cache)\n"
+              << "  --sweep <wav>             benchmark session settings on a file such as ../demo.wav, print the fastest, then exit\n"
+              << "  --warmup <on|off>         run a synthetic chunk through every stage at startup, report cold vs warm latency (default: on)\n";
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef CPP_DEMO_OPTIONS_H
+#define CPP_DEMO_OPTIONS_H
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+struct AppOptions {
+    std::string source = "mic";             // mic | wav:<path> | pcm[:<path>] | synthetic[:<seconds>]
+    std::string pcm_format = "s16le";       // s16le | f32le, for pcm sources
+    std::string pace = "realtime";          // realtime | fast, for non-microphone sources
+    std::string resampler = "polyphase";    // polyphase | libsamplerate, for files and devices not at 16 kHz
+    std::string resample_quality = "medium";    // fast | medium | best
+    std::string vad = "energy";             // energy | adaptive | neural
+    std::string vad_model_path;             // empty: ../vad_onnx/model/silero_vad.onnx
+    float vad_threshold = 0.5f;             // speech probability for the neural detector
+    float vad_on_ratio = 4.0f;              // adaptive detector: onset energy over the noise floor
+    float vad_off_ratio = 2.0f;             // adaptive detector: release energy over the noise floor
+    std::optional<int> hangover_ms;         // unset: 1000, or 400 with the adaptive detector
+    std::optional<int> preroll_ms;          // unset: 0, or 192 with the adaptive detector
+    int max_chunk_ms = 30000;               // 0: never split long speech
+    int split_search_ms = 2000;
+    int split_overlap_ms = 500;
+    int queue_seconds = 120;                // audio budget for chunks waiting to be transcribed
+    std::string overflow = "drop-oldest";   // drop-oldest | drop-newest | merge | block
+    int partial_ms = 0;                     // interim transcript interval during speech, 0: finals only
+    std::vector<std::string> streams;       // [<name>=]<source>, repeatable; empty: the single --source
+    std::string output_dir;                 // empty: labelled lines on stdout, else <dir>/<name>.txt per stream
+    int max_batch = 4;                      // chunks from different streams decoded in one model run
+    int batch_window_ms = 20;               // how long a ready chunk waits for other streams
+    int deadline_ms = 0;                    // live: from a chunk's close to the end of its decode, 0: no deadline
+    std::string stale = "merge";            // skip | merge: queued chunks already past their deadline
+    std::string batch;                      // directory, file list or sound file: transcribe offline, then exit
+    std::string long_file;                  // one long recording: VAD segments decoded in parallel, then exit
+    std::string background;                 // like --batch, but at batch priority alongside the live streams
+    std::string batch_output = "transcripts.jsonl";
+    int workers = 0;                        // batch files or long-file segments decoded at once, 0: one per hardware thread
+    int model_pool = 0;                     // inferences in flight per model, 0: --workers in batch modes, else 1
+    int batch_slots = 0;                    // batch-priority decode steps in flight while live work is idle, 0: no limit
+    int stats_seconds = 0;                  // print per-priority queue depth and wait times this often, 0: at exit only
+    int ort_threads = 0;                    // shared ONNX Runtime intra-op pool for all models, 0: one per core
+    std::string tuning_file;                // per-model session settings, see tuning.h
+    std::vector<std::string> tune;          // <section>.<key>=<value>, repeatable, applied over the file
+    std::string model_cache = "../model_cache";     // optimised models reused across starts, "off" disables
+    std::string sweep;                      // benchmark session settings on this WAV file, then exit
+    std::string warmup = "on";              // on | off: synthetic pass through every stage before real audio
+};
+
+// "name=source" -> {"name", "source"}; a bare source gets an empty name.
+std::pair<std::string, std::string> split_stream_spec(const std::string& spec);
+
+// Accepts "--name value" and "--name=value". Throws std::invalid_argument on bad input.
+AppOptions parse_options(int argc, char* argv[]);
+void print_usage(const char* program);
+
+#endif //CPP_DEMO_OPTIONS_H
@@ -0,0 +1,92 @@
+#include <filesystem>
+#include <iostream>
+
+#include "pipeline.h"
+#include "whisper_process.h"
+#include "utils.h"
+
+
+std::string transcription_model_path(){
+    std::string root = std::filesystem::current_path().string();
+    return root + "/../whisper_onnx/model/whisper.onnx";
+}
+
+std::string translation_model_path(){
+    std::string root = std::filesystem::current_path().string();
+    return root + "/../transformer_onnx/model/No-En-Transformer.onnx";
+}
+
+std::unique_ptr<Transcriber> load_transcription_model(const SessionTuning& tuning){
+    auto transcriber = std::make_unique<Transcriber>();
+    transcriber->load_model(transcription_model_path(), tuning);
+    return transcriber;
+}
+
+static std::string read_whisper_script(const std::string& name){
+    std::string root = std::filesystem::current_path().string();
+    return read_file_string(root + "/../whisper_onnx/scripts/" + name);
+}
+
+std::vector<float> extract_features(const std::vector<float>& audio_data){
+    return process_python_array(audio_data, read_whisper_script("process_script.py"));
+}
+
+// NumPy wraps this without copying, and it keeps its capacity between chunks
+static std::vector<float>& staging_buffer(const AudioBuffer& audio_data){
+    static thread_local std::vector<float> staging;
+    staging.resize(audio_data.size());
+    audio_data.copyTo(0, audio_data.size(), staging.data());
+    return staging;
+}
+
+std::vector<float> extract_features(const AudioBuffer& audio_data){
+    return extract_features(staging_buffer(audio_data));
+}
+
+std::string decode_tokens(const std::vector<int64_t>& token_ids){
+    return process_token_ids(token_ids, read_whisper_script("decode_script.py"));
+}
+
+std::string transcribe(const std::vector<float>& audio_data, const std::unique_ptr<Transcriber>& transcriber,
+                       const std::vector<int64_t>& forced_prefix, std::vector<int64_t>* decoded_ids){
+    Timer timer("whisper");
+    std::vector<float> processed_audio_np = extract_features(audio_data);
+
+    const std::vector<int64_t > token_ids = transcriber->infer(processed_audio_np, forced_prefix);
+    std::string transcribed_sentence = decode_tokens(token_ids);
+    if (decoded_ids)
+        *decoded_ids = token_ids;
+
+    return transcribed_sentence;
+}
+
+std::string transcribe(const AudioBuffer& audio_data, const std::unique_ptr<Transcriber>& transcriber,
+                       const std::vector<int64_t>& forced_prefix, std::vector<int64_t>* decoded_ids){
+    return transcribe(staging_buffer(audio_data), transcriber, forced_prefix, decoded_ids);
+}
+
+std::unique_ptr<Translator> load_translation_model(const SessionTuning& tuning){
+    auto translator = std::make_unique<Translator>();
+    translator->load_model(translation_model_path(), tuning);
+    return translator;
+}
+
+std::unique_ptr<Tokenizer> load_tokenizer(){
+    return std::make_unique<Tokenizer>("no", "en");
+}
+
+std::string translate(const std::string& src_sentence,
+                      const std::unique_ptr<Translator>& translator,
+                      const std::unique_ptr<Tokenizer>& tokenizer,
+                      const Ort::RunOptions* run_options){
+    Timer timer("transformer");
+    if (src_sentence == "<|nocaptions|>")
+        return "...";
+
+    std::string s = tokenizer->preprocessing(src_sentence);
+    std::vector<int64_t> encoder_input = tokenizer->convert_token_to_id(s);
+    std::vector<int> output = translator->infer(encoder_input, run_options);
+    std::string res = tokenizer->decode(output, src_sentence);
+
+    return res;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#ifndef CPP_DEMO_PIPELINE_H
+#define CPP_DEMO_PIPELINE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audio_buffer.h"
+#include "models.h"
+
+
+std::string transcription_model_path();
+std::string translation_model_path();
+// Independent of each other and of Python, so they can load concurrently.
+std::unique_ptr<Transcriber> load_transcription_model(const SessionTuning& tuning = {});
+std::unique_ptr<Translator> load_translation_model(const SessionTuning& tuning = {});
+std::unique_ptr<Tokenizer> load_tokenizer();
+
+// Whisper's log-mel input for one chunk, from the preprocessing script.
+std::vector<float> extract_features(const std::vector<float>& audio_data);
+std::vector<float> extract_features(const AudioBuffer& audio_data);
+// Text of Whisper's output tokens, from the decode script.
+std::string decode_tokens(const std::vector<int64_t>& token_ids);
+
+std::string transcribe(const std::vector<float>& audio_data, const std::unique_ptr<Transcriber>& transcriber,
+                       const std::vector<int64_t>& forced_prefix = {}, std::vector<int64_t>* decoded_ids = nullptr);
+// Gathers the slabs into a reused staging buffer, so the recorder's chunks are copied once on their way to NumPy.
+std::string transcribe(const AudioBuffer& audio_data, const std::unique_ptr<Transcriber>& transcriber,
+                       const std::vector<int64_t>& forced_prefix = {}, std::vector<int64_t>* decoded_ids = nullptr);
+
+// run_options as in Transcriber::infer; only the transformer runs can be terminated, not the scripts.
+std::string translate(const std::string& src_sentence,
+                      const std::unique_ptr<Translator>& translator,
+                      const std::unique_ptr<Tokenizer>& tokenizer,
+                      const Ort::RunOptions* run_options = nullptr);
+
+#endif //CPP_DEMO_PIPELINE_H
@@ -1,28 +1,19 @@
 #include <iostream>
+#include <limits>
 
-#include "portaudio.h"
 #include "recorder.h"
 
 
 static const int SAMPLE_RATE = 16000;
 static const int CHANNELS = 1;
 static const int FRAMES_PER_BUFFER = 1024;
-static constexpr float ENERGY_THRESHOLD = 3.0e-5f;
-static constexpr int SILENCE_FRAMES = SAMPLE_RATE * 1;
+static const int MERGE_LIMIT_SECONDS = 30;     // one Whisper window when chunks are not length-limited
+static const int SPLIT_WINDOW = SAMPLE_RATE / 50;   // 20 ms energy window when looking for a split point
 
 const PaSampleFormat SAMPLE_FORMAT = paFloat32;
 
 
 
-PortAudioHandler::PortAudioHandler(){
-    PaError err = Pa_Initialize();
-    if (err != paNoError) throw PortAudioException(err);
-}
-
-PortAudioHandler::~PortAudioHandler(){
-    Pa_Terminate();
-}
-
 std::vector<float> recordAudio(int durationSeconds) {
     PortAudioHandler paHandler;
     PaStream *stream = nullptr;
@@ -70,115 +61,228 @@ std::vector<float> recordAudio(int durationSeconds) {
     return recordedData;
 }
 
+Recorder::Recorder(RecorderConfig config, std::unique_ptr<VoiceActivityDetector> vad, std::unique_ptr<AudioSource> source)
+        : config(config), vad(std::move(vad)), source(std::move(source)), isRecording(false),
+          slabPool(std::make_shared<AudioSlabPool>()),
+          chunkQueue(static_cast<size_t>(config.queueSeconds * SAMPLE_RATE), config.overflowPolicy,
+                     static_cast<size_t>((config.maxChunkSeconds > 0 ? config.maxChunkSeconds : MERGE_LIMIT_SECONDS) * SAMPLE_RATE)),
+          currentChunk(slabPool), silenceCounter(0) {
+    if (!this->vad) this->vad = std::make_unique<EnergyVad>();
+    if (!this->source) this->source = std::make_unique<PortAudioSource>(config.captureMode, config.ringBufferSeconds);
+}
+
+Recorder::~Recorder() {
+    stop();
+}
+
 void Recorder::start() {
     if (isRecording) return;
 
-    PaError err = Pa_Initialize();
-    if (err != paNoError) throw PortAudioException(err);
+    isActive = false;
+    silenceCounter = 0;
+    currentChunk.clear();
+    vad->reset();
+
+    silenceFrames = static_cast<int>(config.hangoverSeconds * SAMPLE_RATE);
+    prerollBuffers = static_cast<size_t>(config.prerollSeconds * SAMPLE_RATE + FRAMES_PER_BUFFER - 1) / FRAMES_PER_BUFFER;
+    prerollRing.assign(prerollBuffers * FRAMES_PER_BUFFER, 0.0f);
+    prerollNext = 0;
+    prerollCount = 0;
+
+    maxChunkFrames = static_cast<size_t>(config.maxChunkSeconds * SAMPLE_RATE);
+    splitOverlapFrames = static_cast<size_t>(config.splitOverlapSeconds * SAMPLE_RATE);
+    splitSearchFrames = std::max(static_cast<size_t>(config.splitSearchSeconds * SAMPLE_RATE), static_cast<size_t>(SPLIT_WINDOW));
+    partialFrames = static_cast<size_t>(config.partialIntervalSeconds * SAMPLE_RATE);
+    if (maxChunkFrames > 0) {
+        // whatever is carried over must leave room for new audio in the next chunk
+        maxChunkFrames = std::max(maxChunkFrames, splitSearchFrames + splitOverlapFrames + FRAMES_PER_BUFFER);
+    }
+    splitScratch.assign(splitSearchFrames, 0.0f);
 
-    err = Pa_OpenDefaultStream(&stream,
-                               CHANNELS,
-                               0,
-                               SAMPLE_FORMAT,
-                               SAMPLE_RATE,
-                               FRAMES_PER_BUFFER,
-                               nullptr,
-                               nullptr);
-    if (err != paNoError) throw PortAudioException(err);
+    // the open chunk and one partial copy of it; queued chunks grow the pool on demand
+    size_t chunkSlabs = (maxChunkFrames > 0 ? maxChunkFrames : static_cast<size_t>(MERGE_LIMIT_SECONDS * SAMPLE_RATE))
+                        / SLAB_FRAMES + 1;
+    slabPool->reserve(partialFrames > 0 ? 2 * chunkSlabs : chunkSlabs);
 
-    err = Pa_StartStream(stream);
-    if (err != paNoError) throw PortAudioException(err);
+    source->start();
 
+    framesRead = 0;
+    chunkStart = 0;
+    sourceEnded = false;
+    chunkQueue.open();
     isRecording = true;
     recordingThread = std::thread(&Recorder::recordingLoop, this);
-    std::cout << "Recording started, press <Enter> to stop." << std::endl;
+    if (config.verbose)
+        std::cout << "Recording started, press <Enter> to stop." << std::endl;
 }
 
 void Recorder::stop() {
     if (!isRecording) return;
 
     isRecording = false;
+    source->requestStop();
+    chunkQueue.close();
     if (recordingThread.joinable()) {
         recordingThread.join();
     }
 
-    if (stream) {
-        Pa_StopStream(stream);
-        Pa_CloseStream(stream);
-        stream = nullptr;
+    source->stop();
+    if (config.verbose)
+        std::cout << "Recording stopped..." << std::endl;
+    if (getOverrunCount() > 0) {
+        std::cerr << "Capture overruns: " << getOverrunCount() << " (" << getDroppedFrames() << " frames dropped)" << std::endl;
     }
+    ChunkQueueStats stats = chunkQueue.stats();
+    if (stats.droppedChunks > 0 || stats.mergedChunks > 0) {
+        std::cerr << "Chunk queue: " << stats.droppedChunks << " chunks (" << stats.droppedSamples
+                  << " samples) dropped, " << stats.mergedChunks << " merged" << std::endl;
+    }
+}
 
-    Pa_Terminate();
-    std::cout << "Recording stopped..." << std::endl;
+AudioChunk Recorder::getChunk() {
+    return chunkQueue.pop();
 }
 
-std::vector<float> Recorder::getChunk() {
-    std::vector<float> chunk;
-    std::lock_guard<std::mutex> lock(bufferMutex);
-//    std::cout << audioBuffer.size() << " ";
-    if (!audioBuffer.empty()) {
-        chunk = std::move(audioBuffer.front());
-        audioBuffer.pop();
-    }
-    return chunk;
+AudioChunk Recorder::waitChunk(std::chrono::milliseconds timeout) {
+    return chunkQueue.waitPop(timeout);
 }
 
 void Recorder::recordingLoop() {
     std::vector<float> buffer(FRAMES_PER_BUFFER);
-    bool isActive = false;
+    bool ended = false;
 
-    while (isRecording) {
-        PaError err = Pa_ReadStream(stream, buffer.data(), FRAMES_PER_BUFFER);
-        if (err != paNoError) {
-            std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
-            return;
+    while (isRecording && !ended) {
+        size_t filled = readBuffer(buffer);
+        ended = filled < buffer.size();
+        if (filled > 0) processBuffer(buffer);
+        framesRead += buffer.size();
+    }
+
+    // Process any remaining audio
+    if (!currentChunk.empty()) {
+        processAudioChunk(currentChunk);
+    }
+
+    if (ended && isRecording) {
+        sourceEnded = true;
+        chunkQueue.close();
+    }
+}
+
+// Fills the buffer from the source. A short count means the source has ended; the rest is zeroed.
+size_t Recorder::readBuffer(std::vector<float>& buffer) {
+    size_t filled = 0;
+    while (filled < buffer.size()) {
+        size_t n = source->read(buffer.data() + filled, buffer.size() - filled);
+        if (n == 0) {
+            std::fill(buffer.begin() + static_cast<std::ptrdiff_t>(filled), buffer.end(), 0.0f);
+            break;
         }
-        bool currentlyActive = detectVoiceActivity(buffer);
-//        std::cout << currentlyActive << " ";
+        filled += n;
+    }
+    return filled;
+}
 
-        if (currentlyActive) {
-            if (!isActive) {
-                isActive = true;
+void Recorder::processBuffer(const std::vector<float>& buffer) {
+    bool currentlyActive = detectVoiceActivity(buffer);
+//    std::cout << currentlyActive << " ";
+
+    if (currentlyActive) {
+        if (!isActive) {
+            isActive = true;
+            currentChunk.clear();
+            chunkStart = framesRead - prerollCount * FRAMES_PER_BUFFER;
+            flushPreroll();
+            utteranceId++;
+            lastPartialSize = 0;
+        }
+        silenceCounter = 0;
+        currentChunk.append(buffer.data(), buffer.size());
+//        std::cout << currentChunk.size() << " ";
+    } else {
+        if (isActive) {
+            silenceCounter += FRAMES_PER_BUFFER;
+            currentChunk.append(buffer.data(), buffer.size());
+
+            if (silenceCounter >= silenceFrames) {
+                isActive = false;
+                processAudioChunk(currentChunk);
                 currentChunk.clear();
+                silenceCounter = 0;
             }
-            silenceCounter = 0;
-            currentChunk.insert(currentChunk.end(), buffer.begin(), buffer.end());
-//            std::cout << currentChunk.size() << " ";
         } else {
-            if (isActive) {
-                silenceCounter += FRAMES_PER_BUFFER;
-                currentChunk.insert(currentChunk.end(), buffer.begin(), buffer.end());
-
-                if (silenceCounter >= SILENCE_FRAMES) {
-                    isActive = false;
-                    processAudioChunk(currentChunk);
-                    currentChunk.clear();
-                    silenceCounter = 0;
-                }
-            }
+            pushPreroll(buffer);
         }
     }
 
-    // Process any remaining audio
-    if (!currentChunk.empty()) {
-        processAudioChunk(currentChunk);
+    if (isActive && maxChunkFrames > 0 && currentChunk.size() >= maxChunkFrames) {
+        splitChunk();
+    }
+    if (isActive && partialFrames > 0 && currentChunk.size() >= lastPartialSize + partialFrames) {
+        publishPartial();
     }
 }
 
-bool Recorder::detectVoiceActivity(const std::vector<float> &buffer) {
-    float energy = 0.0f;
-    for (float sample : buffer) {
-        energy += sample * sample;
+void Recorder::publishPartial() {
+    lastPartialSize = currentChunk.size();
+    chunkQueue.publishPartial(AudioChunk{currentChunk.copy(0, currentChunk.size()), false, utteranceId, chunkStart,
+                                         std::chrono::steady_clock::now()});
+}
+
+void Recorder::splitChunk() {
+    // cut at the quietest 20 ms window in the last splitSearchFrames before the limit
+    size_t searchEnd = std::min(currentChunk.size(), maxChunkFrames);
+    size_t searchBegin = searchEnd - splitSearchFrames;
+
+    currentChunk.copyTo(searchBegin, splitSearchFrames, splitScratch.data());
+
+    size_t cut = searchEnd;
+    float minEnergy = std::numeric_limits<float>::max();
+    for (size_t begin = 0; begin + SPLIT_WINDOW <= splitSearchFrames; begin += SPLIT_WINDOW / 2) {
+        float energy = 0.0f;
+        for (size_t i = begin; i < begin + SPLIT_WINDOW; ++i) {
+            energy += splitScratch[i] * splitScratch[i];
+        }
+        if (energy < minEnergy) {
+            minEnergy = energy;
+            cut = searchBegin + begin + SPLIT_WINDOW / 2;
+        }
     }
-    energy /= static_cast<float>(buffer.size());
-//    std::cout << energy << " ";
-    return energy > ENERGY_THRESHOLD;
+
+    // the next chunk starts with a short overlap so words at the cut are not lost
+    size_t nextBegin = cut - splitOverlapFrames;
+    AudioBuffer next = currentChunk.copy(nextBegin, currentChunk.size() - nextBegin);
+    currentChunk.truncate(cut);
+    processAudioChunk(currentChunk);
+    currentChunk = std::move(next);
+    chunkStart += nextBegin;
+
+    // the remainder is decoded from scratch, so it is a new utterance for partial results
+    utteranceId++;
+    lastPartialSize = 0;
+}
+
+void Recorder::pushPreroll(const std::vector<float>& buffer) {
+    if (prerollBuffers == 0) return;
+
+    std::copy(buffer.begin(), buffer.end(), prerollRing.begin() + static_cast<std::ptrdiff_t>(prerollNext * FRAMES_PER_BUFFER));
+    prerollNext = (prerollNext + 1) % prerollBuffers;
+    prerollCount = std::min(prerollCount + 1, prerollBuffers);
 }
 
-void Recorder::processAudioChunk(std::vector<float> &chunk) {
-    std::lock_guard<std::mutex> lock(bufferMutex);
-    audioBuffer.push(std::move(chunk));
-    while (audioBuffer.size() > 100) {
-        audioBuffer.pop();
+void Recorder::flushPreroll() {
+    // oldest buffer first
+    for (size_t i = 0; i < prerollCount; ++i) {
+        size_t index = (prerollNext + prerollBuffers - prerollCount + i) % prerollBuffers;
+        currentChunk.append(prerollRing.data() + index * FRAMES_PER_BUFFER, FRAMES_PER_BUFFER);
     }
+    prerollCount = 0;
+}
+
+bool Recorder::detectVoiceActivity(const std::vector<float> &buffer) {
+    return vad->isSpeech(buffer);
+}
+
+void Recorder::processAudioChunk(AudioBuffer &chunk) {
+    chunkQueue.push(AudioChunk{std::move(chunk), true, utteranceId, chunkStart, std::chrono::steady_clock::now()});
 }
@@ -3,47 +3,94 @@
 #ifndef RECORDER_H
 #define RECORDER_H
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <thread>
-#include <queue>
-#include <mutex>
 
-#include "portaudio.h"
+#include "audio_source.h"
+#include "chunk_queue.h"
+#include "vad.h"
 
 
-class PortAudioException : public std::runtime_error {
-public:
-    explicit PortAudioException(PaError err) : std::runtime_error(Pa_GetErrorText(err)), error(err) {}
-    PaError error;
-};
-
-class PortAudioHandler {
-public:
-    PortAudioHandler();
-    ~PortAudioHandler();
+struct RecorderConfig {
+    CaptureMode captureMode = CaptureMode::Callback;    // for the default PortAudio source
+    float ringBufferSeconds = 2.0f;
+    float hangoverSeconds = 1.0f;   // silence after speech before a chunk is closed
+    float prerollSeconds = 0.0f;    // audio kept from just before speech onset
+    float maxChunkSeconds = 30.0f;  // longer speech is split, 0 disables; 30 s is one Whisper window
+    float splitSearchSeconds = 2.0f;    // the split point is the quietest spot this close to the limit
+    float splitOverlapSeconds = 0.5f;   // audio before the split point repeated at the start of the next chunk
+    float partialIntervalSeconds = 0.0f;    // publish a partial of the open chunk this often, 0 disables
+    float queueSeconds = 120.0f;    // budget for finished chunks waiting for the consumer
+    OverflowPolicy overflowPolicy = OverflowPolicy::DropOldest;
+    bool verbose = true;            // start/stop messages on stdout
 };
 
 class Recorder {
 public:
-    Recorder() : stream(nullptr), isRecording(false), silenceCounter(0) {}
-    ~Recorder() {stop();}
+    // Uses EnergyVad and the default PortAudio input when no detector or source is given.
+    explicit Recorder(RecorderConfig config = {}, std::unique_ptr<VoiceActivityDetector> vad = nullptr,
+                      std::unique_ptr<AudioSource> source = nullptr);
+    ~Recorder();
     void start();
     void stop();
-    std::vector<float> getChunk();
+    // Final chunks come first. Only the newest partial is kept, and it is dropped once its utterance is final.
+    AudioChunk getChunk();
+    // Blocks until a chunk is available, the timeout expires or recording stops; empty on timeout.
+    AudioChunk waitChunk(std::chrono::milliseconds timeout);
+    // Readable while chunks are available, for poll/select/kqueue loops; drained by getChunk/waitChunk.
+    int chunkEventFd() const { return chunkQueue.eventFd(); }
+
+    // True once a finite source has ended and every chunk has been queued.
+    bool isFinished() const { return sourceEnded; }
+
+    uint64_t getOverrunCount() const { return source->getOverrunCount(); }
+    uint64_t getDroppedFrames() const { return source->getDroppedFrames(); }
+    ChunkQueueStats getQueueStats() const { return chunkQueue.stats(); }
+    // Slabs ever allocated for chunk audio; flat once capture has warmed up.
+    size_t getAllocatedSlabs() const { return slabPool->allocatedSlabs(); }
 
 private:
-    PaStream* stream;
+    RecorderConfig config;
+    std::unique_ptr<VoiceActivityDetector> vad;
+    std::unique_ptr<AudioSource> source;
     std::atomic<bool> isRecording;
+    std::atomic<bool> sourceEnded{false};
     std::thread recordingThread;
-    std::queue<std::vector<float>> audioBuffer;
-    std::mutex bufferMutex;
+    std::shared_ptr<AudioSlabPool> slabPool;
+    ChunkQueue chunkQueue;
 
     void recordingLoop();
-    static bool detectVoiceActivity(const std::vector<float>& buffer);
-    void processAudioChunk(std::vector<float>& chunk);
+    size_t readBuffer(std::vector<float>& buffer);
+    void processBuffer(const std::vector<float>& buffer);
+    void pushPreroll(const std::vector<float>& buffer);
+    void flushPreroll();
+    void splitChunk();
+    bool detectVoiceActivity(const std::vector<float>& buffer);
+    void processAudioChunk(AudioBuffer& chunk);
+    void publishPartial();
 
 
-    std::vector<float> currentChunk;
+    AudioBuffer currentChunk;
+    std::vector<float> splitScratch;
+    bool isActive = false;
     int silenceCounter;
+    int silenceFrames = 0;
+    size_t maxChunkFrames = 0;
+    size_t splitSearchFrames = 0;
+    size_t splitOverlapFrames = 0;
+    size_t partialFrames = 0;
+    size_t lastPartialSize = 0;
+    uint64_t utteranceId = 0;
+    uint64_t framesRead = 0;        // source position of the buffer being processed
+    uint64_t chunkStart = 0;
+
+    std::vector<float> prerollRing;
+    size_t prerollBuffers = 0;
+    size_t prerollNext = 0;
+    size_t prerollCount = 0;
 };
 
 std::vector<float> recordAudio(int durationSeconds);
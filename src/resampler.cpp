@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "resampler.h"
+
+
+static const size_t MAX_PHASE_ROWS = 1024;  // rates with a larger reduced ratio use the nearest row
+
+struct FilterDesign {
+    double zeroCrossings;
+    double rolloff;     // passband edge as a fraction of the lower Nyquist frequency
+    double kaiserBeta;
+};
+
+static FilterDesign filter_design(ResampleQuality quality) {
+    switch (quality) {
+        case ResampleQuality::Fast: return {8, 0.90, 6.0};
+        case ResampleQuality::Best: return {32, 0.97, 10.0};
+        default: return {16, 0.94, 8.0};
+    }
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+static float dot(const float* a, const float* b, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) acc = vfmaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    sum = vaddvq_f32(acc);
+#elif defined(__SSE__)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < n; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+
+std::unique_ptr<Resampler> Resampler::create(int inputRate, int outputRate, ResamplerConfig config) {
+    if (inputRate <= 0 || outputRate <= 0) {
+        throw std::invalid_argument("Invalid sample rate for resampling");
+    }
+    if (config.backend == ResamplerBackend::Libsamplerate)
+        return std::make_unique<SamplerateResampler>(inputRate, outputRate, config.quality);
+    return std::make_unique<PolyphaseResampler>(inputRate, outputRate, config.quality);
+}
+
+
+PolyphaseResampler::PolyphaseResampler(int inputRate, int outputRate, ResampleQuality quality)
+        : Resampler(inputRate, outputRate) {
+    auto divisor = static_cast<uint64_t>(std::gcd(inputRate, outputRate));
+    upFactor = static_cast<uint64_t>(outputRate) / divisor;
+    downFactor = static_cast<uint64_t>(inputRate) / divisor;
+
+    // the cutoff follows the lower of the two Nyquist frequencies; the filter is longer when it is lower
+    // so every quality keeps the same number of zero crossings
+    FilterDesign design = filter_design(quality);
+    double cutoff = design.rolloff * std::min(1.0, static_cast<double>(outputRate) / inputRate);
+    halfTaps = static_cast<size_t>(std::ceil(design.zeroCrossings / cutoff));
+    taps = (2 * halfTaps + 3) / 4 * 4;
+    phaseRows = static_cast<size_t>(std::min<uint64_t>(upFactor, MAX_PHASE_ROWS));
+
+    // row r is the filter for an output that lies r / phaseRows of an input sample after the tap at halfTaps - 1;
+    // the extra last row (a whole sample later) saves a wrap-around when rounding to the nearest row
+    const double pi = 3.14159265358979323846;
+    const double norm = bessel_i0(design.kaiserBeta);
+    table.assign((phaseRows + 1) * taps, 0.0f);
+    for (size_t r = 0; r <= phaseRows; ++r) {
+        double frac = static_cast<double>(r) / static_cast<double>(phaseRows);
+        for (size_t j = 0; j < 2 * halfTaps; ++j) {
+            double d = static_cast<double>(j) - static_cast<double>(halfTaps - 1) - frac;
+            double x = d / static_cast<double>(halfTaps);
+            if (std::abs(x) > 1.0) continue;
+
+            double arg = pi * cutoff * d;
+            double sinc = std::abs(arg) < 1e-9 ? 1.0 : std::sin(arg) / arg;
+            double window = bessel_i0(design.kaiserBeta * std::sqrt(1.0 - x * x)) / norm;
+            table[r * taps + j] = static_cast<float>(cutoff * sinc * window);
+        }
+    }
+
+    reset();
+}
+
+void PolyphaseResampler::reset() {
+    // leading zeros so that the first output is centred on the first input sample
+    history.assign(halfTaps - 1, 0.0f);
+    position = 0;
+    phase = 0;
+    inputFrames = 0;
+    outputFrames = 0;
+}
+
+void PolyphaseResampler::process(const float* input, size_t frames, std::vector<float>& out) {
+    history.insert(history.end(), input, input + frames);
+    inputFrames += frames;
+    produce(out, UINT64_MAX);
+}
+
+void PolyphaseResampler::flush(std::vector<float>& out) {
+    uint64_t expected = (inputFrames * upFactor + downFactor - 1) / downFactor;
+    history.insert(history.end(), taps, 0.0f);
+    produce(out, expected);
+}
+
+void PolyphaseResampler::produce(std::vector<float>& out, uint64_t limit) {
+    while (outputFrames < limit && position + taps <= history.size()) {
+        size_t row = phaseRows == upFactor ? phase : (phase * phaseRows + upFactor / 2) / upFactor;
+        out.push_back(dot(history.data() + position, table.data() + row * taps, taps));
+        outputFrames++;
+
+        phase += downFactor;
+        position += phase / upFactor;
+        phase %= upFactor;
+    }
+
+    // input before the next output's first tap can no longer contribute
+    size_t consumed = std::min(position, history.size());
+    history.erase(history.begin(), history.begin() + static_cast<std::ptrdiff_t>(consumed));
+    position -= consumed;
+}
+
+
+static int converter_type(ResampleQuality quality) {
+    switch (quality) {
+        case ResampleQuality::Fast: return SRC_SINC_FASTEST;
+        case ResampleQuality::Best: return SRC_SINC_BEST_QUALITY;
+        default: return SRC_SINC_MEDIUM_QUALITY;
+    }
+}
+
+SamplerateResampler::SamplerateResampler(int inputRate, int outputRate, ResampleQuality quality)
+        : Resampler(inputRate, outputRate), ratio(static_cast<double>(outputRate) / inputRate) {
+    int error = 0;
+    state = src_new(converter_type(quality), 1, &error);
+    if (!state) {
+        throw std::runtime_error(std::string("libsamplerate: ") + src_strerror(error));
+    }
+}
+
+SamplerateResampler::~SamplerateResampler() {
+    if (state) src_delete(state);
+}
+
+void SamplerateResampler::process(const float* input, size_t frames, std::vector<float>& out) {
+    run(input, frames, false, out);
+}
+
+void SamplerateResampler::flush(std::vector<float>& out) {
+    run(nullptr, 0, true, out);
+}
+
+void SamplerateResampler::reset() {
+    src_reset(state);
+}
+
+void SamplerateResampler::run(const float* input, size_t frames, bool endOfInput, std::vector<float>& out) {
+    SRC_DATA data{};
+    data.data_in = input;
+    data.input_frames = static_cast<long>(frames);
+    data.end_of_input = endOfInput ? 1 : 0;
+    data.src_ratio = ratio;
+
+    while (true) {
+        size_t offset = out.size();
+        auto capacity = static_cast<size_t>(static_cast<double>(data.input_frames) * ratio) + 256;
+        out.resize(offset + capacity);
+        data.data_out = out.data() + offset;
+        data.output_frames = static_cast<long>(capacity);
+
+        int error = src_process(state, &data);
+        if (error != 0) {
+            out.resize(offset);
+            throw std::runtime_error(std::string("libsamplerate: ") + src_strerror(error));
+        }
+        out.resize(offset + static_cast<size_t>(data.output_frames_gen));
+
+        data.data_in += data.input_frames_used;
+        data.input_frames -= data.input_frames_used;
+        // done once the input is used up and, at the end, the filter tail has drained
+        if (data.input_frames == 0 && (!endOfInput || data.output_frames_gen == 0)) break;
+    }
+}
+
+
+void ResampleFifo::reset(std::unique_ptr<Resampler> newResampler) {
+    resampler = std::move(newResampler);
+    output.clear();
+    readPos = 0;
+}
+
+void ResampleFifo::push(const float* input, size_t frames) {
+    resampler->process(input, frames, output);
+}
+
+void ResampleFifo::finish() {
+    resampler->flush(output);
+}
+
+size_t ResampleFifo::pop(float* out, size_t frames) {
+    size_t n = std::min(frames, available());
+    std::copy_n(output.begin() + static_cast<std::ptrdiff_t>(readPos), n, out);
+    readPos += n;
+
+    // compact once the consumed part dominates, so the vector keeps a steady capacity
+    if (readPos > output.size() / 2) {
+        output.erase(output.begin(), output.begin() + static_cast<std::ptrdiff_t>(readPos));
+        readPos = 0;
+    }
+    return n;
+}
+
+
+std::vector<float> resample(const std::vector<float>& input, int inputRate, int outputRate, ResamplerConfig config) {
+    if (inputRate == outputRate) return input;
+
+    auto resampler = Resampler::create(inputRate, outputRate, config);
+    std::vector<float> output;
+    output.reserve(input.size() * static_cast<size_t>(outputRate) / static_cast<size_t>(inputRate) + 1);
+    resampler->process(input.data(), input.size(), output);
+    resampler->flush(output);
+    return output;
+}
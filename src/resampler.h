@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "samplerate.h"
+
+
+enum class ResampleQuality {
+    Fast,       // short filter, wider transition band
+    Medium,
+    Best        // long filter, passband close to the output Nyquist frequency
+};
+
+enum class ResamplerBackend {
+    Polyphase,      // in-house windowed-sinc polyphase filter
+    Libsamplerate
+};
+
+struct ResamplerConfig {
+    ResamplerBackend backend = ResamplerBackend::Polyphase;
+    ResampleQuality quality = ResampleQuality::Medium;
+};
+
+// Mono streaming sample-rate converter. Input can arrive in blocks of any size; the output is the same
+// as converting the whole signal at once.
+class Resampler {
+public:
+    static std::unique_ptr<Resampler> create(int inputRate, int outputRate, ResamplerConfig config = {});
+    virtual ~Resampler() = default;
+
+    // Appends whatever output the new input completes to out.
+    virtual void process(const float* input, size_t frames, std::vector<float>& out) = 0;
+    // Appends the remaining output at the end of the stream, about input * outputRate / inputRate in total.
+    virtual void flush(std::vector<float>& out) = 0;
+    virtual void reset() = 0;
+
+    int getInputRate() const { return inputRate; }
+    int getOutputRate() const { return outputRate; }
+
+protected:
+    Resampler(int inputRate, int outputRate) : inputRate(inputRate), outputRate(outputRate) {}
+
+    int inputRate;
+    int outputRate;
+};
+
+// Produces exactly ceil(input * outputRate / inputRate) frames.
+class PolyphaseResampler : public Resampler {
+public:
+    PolyphaseResampler(int inputRate, int outputRate, ResampleQuality quality);
+
+    void process(const float* input, size_t frames, std::vector<float>& out) override;
+    void flush(std::vector<float>& out) override;
+    void reset() override;
+
+private:
+    uint64_t upFactor;      // output rate / gcd
+    uint64_t downFactor;    // input rate / gcd
+    size_t halfTaps;
+    size_t taps;            // per phase, padded to a multiple of 4 for the SIMD dot product
+    size_t phaseRows;       // filter rows for fractional delays 0, 1/rows, ..., 1
+    std::vector<float> table;
+
+    std::vector<float> history;
+    size_t position = 0;    // index in history of the first tap of the next output
+    uint64_t phase = 0;     // fractional part of the next output time, in 1/upFactor input samples
+    uint64_t inputFrames = 0;
+    uint64_t outputFrames = 0;
+
+    void produce(std::vector<float>& out, uint64_t limit);
+};
+
+class SamplerateResampler : public Resampler {
+public:
+    SamplerateResampler(int inputRate, int outputRate, ResampleQuality quality);
+    ~SamplerateResampler() override;
+    SamplerateResampler(const SamplerateResampler&) = delete;
+    SamplerateResampler& operator=(const SamplerateResampler&) = delete;
+
+    void process(const float* input, size_t frames, std::vector<float>& out) override;
+    void flush(std::vector<float>& out) override;
+    void reset() override;
+
+private:
+    SRC_STATE* state = nullptr;
+    double ratio;
+
+    void run(const float* input, size_t frames, bool endOfInput, std::vector<float>& out);
+};
+
+// The output side of a Resampler, handed out in whatever block sizes the reader asks for.
+// Inactive (no resampler) when the source already runs at the target rate.
+class ResampleFifo {
+public:
+    void reset(std::unique_ptr<Resampler> resampler);
+    bool active() const { return resampler != nullptr; }
+
+    void push(const float* input, size_t frames);
+    // End of input: the filter tail becomes available.
+    void finish();
+    size_t available() const { return output.size() - readPos; }
+    size_t pop(float* out, size_t frames);
+
+private:
+    std::unique_ptr<Resampler> resampler;
+    std::vector<float> output;
+    size_t readPos = 0;
+};
+
+// Whole-signal convenience wrapper.
+std::vector<float> resample(const std::vector<float>& input, int inputRate, int outputRate, ResamplerConfig config = {});
+
+#endif //RESAMPLER_H
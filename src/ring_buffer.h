@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread.
+// Neither side ever blocks or allocates, so the producer can be a real-time audio callback.
+template <typename T>
+class SpscRingBuffer {
+public:
+    explicit SpscRingBuffer(size_t minCapacity) {
+        size_t capacity = 1;
+        while (capacity < minCapacity) capacity <<= 1;
+        buffer.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    size_t capacity() const { return buffer.size(); }
+
+    // Producer side. Writes as much of data as fits and returns the number of elements written.
+    size_t write(const T* data, size_t count) {
+        const size_t head = writeIndex.load(std::memory_order_relaxed);
+        const size_t tail = readIndex.load(std::memory_order_acquire);
+        const size_t n = std::min(count, buffer.size() - (head - tail));
+
+        const size_t first = std::min(n, buffer.size() - (head & mask));
+        std::copy(data, data + first, buffer.begin() + static_cast<std::ptrdiff_t>(head & mask));
+        std::copy(data + first, data + n, buffer.begin());
+
+        writeIndex.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer side. Reads up to count elements and returns the number of elements read.
+    size_t read(T* data, size_t count) {
+        const size_t tail = readIndex.load(std::memory_order_relaxed);
+        const size_t head = writeIndex.load(std::memory_order_acquire);
+        const size_t n = std::min(count, head - tail);
+
+        const size_t first = std::min(n, buffer.size() - (tail & mask));
+        auto start = buffer.begin() + static_cast<std::ptrdiff_t>(tail & mask);
+        std::copy(start, start + static_cast<std::ptrdiff_t>(first), data);
+        std::copy(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(n - first), data + first);
+
+        readIndex.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t readAvailable() const {
+        return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+    }
+
+    size_t writeAvailable() const {
+        return buffer.size() - readAvailable();
+    }
+
+private:
+    std::vector<T> buffer;
+    size_t mask = 0;
+
+    // indices grow monotonically and are masked on access; kept on separate cache lines
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> readIndex{0};
+};
+
+#endif //RING_BUFFER_H
@@ -0,0 +1,93 @@
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "runtime_context.h"
+#include "model_cache.h"
+
+
+static Ort::ThreadingOptions threading_options(const RuntimeConfig& config) {
+    Ort::ThreadingOptions options;
+    if (config.intra_op_threads > 0) options.SetGlobalIntraOpNumThreads(config.intra_op_threads);
+    if (config.inter_op_threads > 0) options.SetGlobalInterOpNumThreads(config.inter_op_threads);
+    return options;
+}
+
+RuntimeContext& RuntimeContext::instance(const RuntimeConfig& config) {
+    static RuntimeContext context(config);
+    return context;
+}
+
+RuntimeContext::RuntimeContext(const RuntimeConfig& config)
+        : runtime_config(config),
+          ort_env(threading_options(config), ORT_LOGGING_LEVEL_WARNING, "cpp_demo"),
+          session_scheduler(config.batch_slots) {}
+
+Ort::SessionOptions RuntimeContext::session_options(const SessionTuning& tuning) const {
+    Ort::SessionOptions options;
+    if (tuning.intra_op_threads > 0 || tuning.inter_op_threads > 0) {
+        if (tuning.intra_op_threads > 0) options.SetIntraOpNumThreads(tuning.intra_op_threads);
+        if (tuning.inter_op_threads > 0) options.SetInterOpNumThreads(tuning.inter_op_threads);
+        if (!tuning.affinity.empty())
+            options.AddConfigEntry("session.intra_op_thread_affinities", tuning.affinity.c_str());
+    } else if (!tuning.affinity.empty()) {
+        throw std::invalid_argument("Thread affinity needs intra_op_threads; the shared pool cannot be pinned per model");
+    } else {
+        options.DisablePerSessionThreads();
+    }
+
+    options.SetExecutionMode(tuning.parallel_execution ? ORT_PARALLEL : ORT_SEQUENTIAL);
+    options.SetGraphOptimizationLevel(tuning.optimization);
+    if (!tuning.mem_pattern) options.DisableMemPattern();
+    if (!tuning.cpu_arena) options.DisableCpuMemArena();
+    return options;
+}
+
+Ort::Session RuntimeContext::create_session(const std::string& model_path, const SessionTuning& tuning) {
+    if (!runtime_config.model_cache_dir.empty()) {
+        try {
+            return create_cached_session(model_path, tuning);
+        } catch (const std::exception& e) {
+            // a cache problem must never keep a model from loading; a broken model fails again below
+            std::cerr << "Model cache unavailable for " << model_path << ": " << e.what() << std::endl;
+        }
+    }
+    return Ort::Session(ort_env, model_path.c_str(), session_options(tuning), prepacked_weights);
+}
+
+Ort::Session RuntimeContext::create_cached_session(const std::string& model_path, const SessionTuning& tuning) {
+    const std::string cached = model_cache_path(runtime_config.model_cache_dir, model_path, tuning);
+
+    if (std::filesystem::exists(cached)) {
+        Ort::SessionOptions options = session_options(tuning);
+        options.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+        try {
+            return Ort::Session(ort_env, cached.c_str(), options, prepacked_weights);
+        } catch (const Ort::Exception& e) {
+            std::cerr << "Discarding unreadable cached model " << cached << ": " << e.what() << std::endl;
+            std::filesystem::remove(cached);
+        }
+    }
+
+    std::filesystem::create_directories(runtime_config.model_cache_dir);
+    // written under a private name and renamed into place, so an instance starting at the same time
+    // never loads half a file
+    const std::string partial = cached + "." + std::to_string(getpid()) + ".tmp";
+    Ort::SessionOptions options = session_options(tuning);
+    options.SetOptimizedModelFilePath(partial.c_str());
+    options.AddConfigEntry("session.save_model_format", "ORT");
+
+    Ort::Session session{nullptr};
+    std::error_code error;
+    try {
+        session = Ort::Session(ort_env, model_path.c_str(), options, prepacked_weights);
+    } catch (...) {
+        // the optimised model may already be partly written
+        std::filesystem::remove(partial, error);
+        throw;
+    }
+    std::filesystem::rename(partial, cached, error);
+    if (error) std::filesystem::remove(partial, error);
+    return session;
+}
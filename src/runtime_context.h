@@ -0,0 +1,67 @@
+#pragma once
+
+#ifndef CPP_DEMO_RUNTIME_CONTEXT_H
+#define CPP_DEMO_RUNTIME_CONTEXT_H
+
+#include <string>
+
+#include "onnxruntime_cxx_api.h"
+#include "session_scheduler.h"
+
+
+// Session options of one model. With no thread counts set, the model runs on the shared global pools; setting
+// either gives it a pool of its own, which is what affinity pins to cores.
+struct SessionTuning {
+    int intra_op_threads = 0;
+    int inter_op_threads = 0;       // only used with parallel execution
+    bool parallel_execution = false;
+    GraphOptimizationLevel optimization = ORT_ENABLE_ALL;
+    bool mem_pattern = true;
+    bool cpu_arena = true;
+    std::string affinity;           // session.intra_op_thread_affinities, e.g. "1,2;3,4" for 3 threads
+};
+
+struct RuntimeConfig {
+    int intra_op_threads = 0;   // size of the shared intra-op pool, 0: ONNX Runtime's default (one per core)
+    int inter_op_threads = 1;
+    std::string model_cache_dir;    // optimised models saved here and reused on later starts, empty: off
+    size_t batch_slots = 0;     // batch-priority decode steps in flight at once, 0: no limit, see SessionScheduler
+};
+
+// Process-wide ONNX Runtime state shared by every model: one Env whose global thread pools all sessions run
+// on, instead of each session starting an intra-op pool of its own and competing for the same cores, and one
+// PrepackedWeightsContainer, so sessions over the same weights keep a single prepacked copy in memory.
+//
+// ONNX Runtime allows one Env per process and ignores the threading options of any later one, so the context
+// must be created before the first session, including the neural VAD's.
+class RuntimeContext {
+public:
+    // The first call creates the context from config; later calls return it unchanged.
+    static RuntimeContext& instance(const RuntimeConfig& config = {});
+
+    RuntimeContext(const RuntimeContext&) = delete;
+    RuntimeContext& operator=(const RuntimeContext&) = delete;
+
+    const RuntimeConfig& config() const { return runtime_config; }
+    Ort::Env& env() { return ort_env; }
+    // Every model's decode steps pass through it.
+    SessionScheduler& scheduler() { return session_scheduler; }
+
+    // Throws std::invalid_argument for an affinity without a thread count.
+    Ort::SessionOptions session_options(const SessionTuning& tuning = {}) const;
+    // Loads a model on the shared Env with the shared prepacked weights. With a model cache, the first start saves
+    // the optimised graph and later starts load it with optimisation off, skipping the passes.
+    Ort::Session create_session(const std::string& model_path, const SessionTuning& tuning = {});
+
+private:
+    explicit RuntimeContext(const RuntimeConfig& config);
+
+    RuntimeConfig runtime_config;
+    Ort::Env ort_env;
+    Ort::PrepackedWeightsContainer prepacked_weights;
+    SessionScheduler session_scheduler;
+
+    Ort::Session create_cached_session(const std::string& model_path, const SessionTuning& tuning);
+};
+
+#endif //CPP_DEMO_RUNTIME_CONTEXT_H
@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <poll.h>
+
+#include "scheduler.h"
+#include "pipeline.h"
+#include "utils.h"
+
+
+static constexpr auto IDLE_POLL = std::chrono::milliseconds(100);
+// the last few tokens of a partial were decoded from audio cut mid-word, so they are re-decoded
+static const size_t PARTIAL_PREFIX_ROLLBACK = 2;
+// stale chunks are merged up to one Whisper window
+static const size_t MERGE_LIMIT_FRAMES = 30 * 16000;
+
+
+StreamScheduler::StreamScheduler(SchedulerConfig config, const std::unique_ptr<Transcriber>& transcriber,
+                                 const std::unique_ptr<Translator>& translator,
+                                 const std::unique_ptr<Tokenizer>& tokenizer)
+        : config(config), transcriber(transcriber), translator(translator), tokenizer(tokenizer) {
+    if (this->config.maxBatch == 0) this->config.maxBatch = 1;
+}
+
+void StreamScheduler::addStream(std::string name, std::unique_ptr<Recorder> recorder,
+                                std::unique_ptr<std::ostream> output) {
+    Stream stream;
+    stream.name = std::move(name);
+    stream.recorder = std::move(recorder);
+    stream.output = std::move(output);
+    streams.push_back(std::move(stream));
+}
+
+void StreamScheduler::startCapture() {
+    if (captureStarted) return;
+    for (auto& stream : streams) stream.recorder->start();
+    captureStarted = true;
+}
+
+void StreamScheduler::run(const std::atomic<bool>& shouldExit) {
+    if (config.maxBatch > 1 && !transcriber->supports_batch()) {
+        std::cerr << "Whisper model has a fixed batch size of 1, decoding one chunk at a time" << std::endl;
+        config.maxBatch = 1;
+    }
+    startCapture();
+
+    StageQueue<Batch> featureQueue(config.stageQueueDepth);
+    StageQueue<Batch> transcribeQueue(config.stageQueueDepth);
+    StageQueue<Batch> translateQueue(config.stageQueueDepth);
+    StageQueue<Batch> outputQueue(config.stageQueueDepth);
+
+    std::vector<std::thread> stages;
+    stages.emplace_back(&StreamScheduler::featureStage, this, std::ref(featureQueue), std::ref(transcribeQueue));
+    stages.emplace_back(&StreamScheduler::transcribeStage, this, std::ref(transcribeQueue), std::ref(translateQueue));
+    stages.emplace_back(&StreamScheduler::translateStage, this, std::ref(translateQueue), std::ref(outputQueue));
+    stages.emplace_back(&StreamScheduler::outputStage, this, std::ref(outputQueue));
+
+    while (!shouldExit) {
+        // read before collecting: a recorder flags itself finished only after its last chunk is queued
+        bool allFinished = std::all_of(streams.begin(), streams.end(),
+                                       [](const Stream& stream) { return stream.recorder->isFinished(); });
+
+        Batch batch = collectBatch();
+        if (batch.empty()) {
+            if (allFinished) break;
+            continue;
+        }
+        featureQueue.push(std::move(batch));
+    }
+
+    // each stage closes its output once its input is drained
+    featureQueue.close();
+    for (auto& stage : stages) stage.join();
+
+    for (auto& stream : streams) stream.recorder->stop();
+    captureStarted = false;
+}
+
+bool StreamScheduler::waitReady(std::chrono::milliseconds timeout, const std::vector<bool>& taken) {
+    std::vector<pollfd> fds;
+    for (size_t i = 0; i < streams.size(); ++i) {
+        if (taken[i]) continue;
+        if (!streams[i].carry.empty()) return true;
+        fds.push_back({streams[i].recorder->chunkEventFd(), POLLIN, 0});
+    }
+    if (fds.empty()) return false;
+
+    return poll(fds.data(), fds.size(), static_cast<int>(timeout.count())) > 0;
+}
+
+void StreamScheduler::takeReady(Batch& batch, std::vector<bool>& taken) {
+    const size_t limit = config.maxBatch;
+    for (size_t n = 0; n < streams.size() && batch.size() < limit; ++n) {
+        size_t i = (nextStream + n) % streams.size();
+        if (taken[i]) continue;
+
+        DeadlineWatchdog::Clock::time_point deadline;
+        AudioChunk chunk = takeChunk(streams[i], deadline);
+        if (chunk.empty()) continue;
+        size_t frames = chunk.samples.size();
+        batch.push_back({&streams[i], std::move(chunk), {}, {}, {}, frames, deadline});
+        taken[i] = true;
+    }
+    nextStream = (nextStream + 1) % streams.size();
+}
+
+AudioChunk StreamScheduler::takeChunk(Stream& stream, DeadlineWatchdog::Clock::time_point& deadline) {
+    while (true) {
+        AudioChunk chunk = stream.carry.empty() ? stream.recorder->getChunk() : std::exchange(stream.carry, AudioChunk{});
+        deadline = DeadlineWatchdog::Clock::time_point::max();
+        if (chunk.empty() || config.deadline.count() == 0) return chunk;
+
+        const auto now = DeadlineWatchdog::Clock::now();
+        deadline = chunk.closedAt + config.deadline;
+        if (now < deadline) return chunk;
+
+        if (chunk.final && config.stalePolicy == StalePolicy::Merge) {
+            mergeQueued(stream, chunk);
+            deadline = now + config.deadline;
+            return chunk;
+        }
+        reportStale(stream, chunk.samples.size(), chunk.closedAt, "skipped");
+    }
+}
+
+// Finals come out of the queue before the partial, so the first partial ends the run of finals.
+void StreamScheduler::mergeQueued(Stream& stream, AudioChunk& chunk) {
+    size_t merged = 1;
+    while (true) {
+        AudioChunk next = stream.recorder->getChunk();
+        if (next.empty()) break;
+        if (!next.final || chunk.samples.size() + next.samples.size() > MERGE_LIMIT_FRAMES) {
+            stream.carry = std::move(next);
+            break;
+        }
+        chunk.samples.append(next.samples);
+        chunk.utterance = next.utterance;
+        chunk.closedAt = next.closedAt;
+        merged++;
+    }
+    if (merged > 1)
+        reportStale(stream, chunk.samples.size(), chunk.closedAt, "merged from " + std::to_string(merged) + " chunks");
+}
+
+StreamScheduler::Batch StreamScheduler::collectBatch() {
+    Batch batch;
+    std::vector<bool> taken(streams.size(), false);
+    if (!waitReady(IDLE_POLL, taken)) return batch;
+
+    takeReady(batch, taken);
+
+    const size_t limit = config.maxBatch;
+    auto deadline = std::chrono::steady_clock::now() + config.batchWindow;
+    while (!batch.empty() && batch.size() < limit) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0 || !waitReady(remaining, taken)) break;
+        takeReady(batch, taken);
+    }
+    return batch;
+}
+
+void StreamScheduler::featureStage(StageQueue<Batch>& input, StageQueue<Batch>& output) {
+    Batch batch;
+    while (input.pop(batch)) {
+        for (auto& pending : batch) {
+            try {
+                pending.features = extract_features(pending.chunk.samples);
+                // the script reports its errors on stderr and hands back nothing
+                if (pending.features.empty()) abandon(pending, "feature extraction failed");
+            } catch (const std::exception& e) {
+                abandon(pending, std::string("feature extraction failed: ") + e.what());
+            }
+            // hand the slabs back to the recorder now rather than after translation
+            pending.chunk.samples.clear();
+        }
+        output.push(std::move(batch));
+    }
+    output.close();
+}
+
+void StreamScheduler::transcribeStage(StageQueue<Batch>& input, StageQueue<Batch>& output) {
+    Batch batch;
+    while (input.pop(batch)) {
+        // chunks that went stale on their way here are not decoded at all
+        std::vector<PendingChunk*> live;
+        const auto now = DeadlineWatchdog::Clock::now();
+        for (auto& pending : batch) {
+            if (pending.abandoned) continue;
+            if (now < pending.deadline) live.push_back(&pending);
+            else abandon(pending, "dropped before decoding");
+        }
+
+        std::vector<std::vector<int64_t>> prefixes(live.size());
+        auto latest = DeadlineWatchdog::Clock::time_point::min();
+        for (size_t i = 0; i < live.size(); ++i) {
+            const Stream& stream = *live[i]->stream;
+            if (live[i]->chunk.utterance == stream.partialUtterance && stream.partialIds.size() > PARTIAL_PREFIX_ROLLBACK)
+                prefixes[i].assign(stream.partialIds.begin(), stream.partialIds.end() - PARTIAL_PREFIX_ROLLBACK);
+            latest = std::max(latest, live[i]->deadline);
+        }
+
+        std::vector<std::vector<int64_t>> decodedIds;
+        if (!live.empty()) {
+            // a batch is only cut short once none of its chunks can make it any more
+            Ort::RunOptions runOptions;
+            DeadlineWatchdog::Watch watch = watchdog.watch(runOptions, latest);
+            try {
+                decodedIds = decodeBatch(live, prefixes, runOptions, watch);
+            } catch (const std::exception& e) {
+                std::string what = watch.expired() ? "abandoned mid-decode" : std::string("decode failed: ") + e.what();
+                for (auto* pending : live) {
+                    if (!pending->abandoned) abandon(*pending, what);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < live.size(); ++i) {
+            PendingChunk& pending = *live[i];
+            Stream& stream = *pending.stream;
+            if (pending.abandoned) continue;
+            try {
+                pending.transcript = decode_tokens(decodedIds[i]);
+            } catch (const std::exception& e) {
+                abandon(pending, std::string("token decoding failed: ") + e.what());
+                continue;
+            }
+            if (pending.chunk.final) {
+                stream.partialIds.clear();
+            } else {
+                stream.partialIds = std::move(decodedIds[i]);
+                stream.partialUtterance = pending.chunk.utterance;
+            }
+        }
+        // an abandoned final still ends its utterance
+        for (auto& pending : batch) {
+            if (pending.abandoned && pending.chunk.final) pending.stream->partialIds.clear();
+        }
+        output.push(std::move(batch));
+    }
+    output.close();
+}
+
+void StreamScheduler::translateStage(StageQueue<Batch>& input, StageQueue<Batch>& output) {
+    Batch batch;
+    while (input.pop(batch)) {
+        // partials pass through untranslated, so they cannot overtake the final of an earlier utterance
+        for (auto& pending : batch) {
+            if (!pending.chunk.final || pending.abandoned) continue;
+            if (DeadlineWatchdog::Clock::now() >= pending.deadline) {
+                pending.untranslated = true;
+                reportStale(*pending.stream, pending.frames, pending.chunk.closedAt, "left untranslated");
+                continue;
+            }
+
+            Ort::RunOptions runOptions;
+            DeadlineWatchdog::Watch watch = watchdog.watch(runOptions, pending.deadline);
+            try {
+                pending.translation = translate(pending.transcript, translator, tokenizer, &runOptions);
+            } catch (const std::exception& e) {
+                pending.untranslated = true;
+                reportStale(*pending.stream, pending.frames, pending.chunk.closedAt,
+                            watch.expired() ? "left untranslated" : std::string("translation failed: ") + e.what());
+            }
+        }
+        output.push(std::move(batch));
+    }
+    output.close();
+}
+
+void StreamScheduler::outputStage(StageQueue<Batch>& input) {
+    Batch batch;
+    while (input.pop(batch)) {
+        for (auto& pending : batch) {
+            try {
+                writeResult(pending);
+            } catch (const std::exception& e) {
+                std::cerr << "Could not write a result: " << e.what() << std::endl;
+            }
+        }
+    }
+}
+
+void StreamScheduler::writeResult(PendingChunk& pending) {
+    Stream& stream = *pending.stream;
+    std::ostream& out = outputOf(stream);
+    std::string label = stream.name.empty() ? "" : "[" + stream.name + "] ";
+
+    if (pending.abandoned) {
+        // reported when it was given up
+    } else if (!pending.chunk.final) {
+        out << label << "... " << pending.transcript << std::endl;
+    } else if (pending.untranslated) {
+        // the translation missed the deadline or failed; the transcript is still worth showing
+        out << label << pending.transcript << std::endl;
+    } else if (!pending.translation.empty()) {
+        out << "******************************************" << "\n";
+        out << label << pending.translation << std::endl;
+        out << "******************************************" << "\n";
+    }
+}
+
+std::vector<std::vector<int64_t>> StreamScheduler::decodeBatch(const std::vector<PendingChunk*>& batch,
+                                                               const std::vector<std::vector<int64_t>>& prefixes,
+                                                               const Ort::RunOptions& runOptions,
+                                                               const DeadlineWatchdog::Watch& watch) {
+    Timer timer(batch.size() > 1 ? "whisper x" + std::to_string(batch.size()) : "whisper");
+    std::vector<std::vector<float>> features;
+    features.reserve(batch.size());
+    for (auto* pending : batch) features.push_back(std::move(pending->features));
+
+    if (batch.size() > 1) {
+        try {
+            return transcriber->infer_batch(features, prefixes, &runOptions);
+        } catch (const Ort::Exception& e) {
+            if (watch.expired()) throw;
+            std::cerr << "Batched decode failed, retrying one chunk at a time: " << e.what() << std::endl;
+        }
+    }
+
+    std::vector<std::vector<int64_t>> decodedIds;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        try {
+            decodedIds.push_back(transcriber->infer(features[i], prefixes[i], &runOptions));
+        } catch (const std::exception& e) {
+            // one bad chunk must not take the rest of the batch with it
+            if (watch.expired()) throw;
+            abandon(*batch[i], std::string("decode failed: ") + e.what());
+            decodedIds.emplace_back();
+        }
+    }
+    return decodedIds;
+}
+
+std::ostream& StreamScheduler::outputOf(Stream& stream) {
+    return stream.output ? *stream.output : std::cout;
+}
+
+void StreamScheduler::reportStale(const Stream& stream, size_t frames, DeadlineWatchdog::Clock::time_point closedAt,
+                                  const std::string& what) {
+    std::chrono::duration<float> behind = DeadlineWatchdog::Clock::now() - closedAt;
+    std::string label = stream.name.empty() ? "" : "[" + stream.name + "] ";
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1) << label << static_cast<float>(frames) / 16000.0f << " s of audio, "
+         << behind.count() << " s behind live, " << what;
+    std::cerr << line.str() << std::endl;
+}
+
+void StreamScheduler::abandon(PendingChunk& pending, const std::string& what) {
+    pending.abandoned = true;
+    reportStale(*pending.stream, pending.frames, pending.chunk.closedAt, what);
+}
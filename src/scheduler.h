@@ -0,0 +1,125 @@
+#pragma once
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "deadline_watchdog.h"
+#include "models.h"
+#include "recorder.h"
+#include "stage_queue.h"
+
+
+// What happens to a queued chunk that is already past its deadline when the scheduler takes it.
+enum class StalePolicy {
+    Skip,   // drop it
+    Merge   // append the stream's other queued final chunks to it, up to one Whisper window, and decode them
+            // together with a fresh deadline; stale partials are always dropped
+};
+
+struct SchedulerConfig {
+    size_t maxBatch = 4;    // chunks from different streams decoded together, 1 disables batching
+    std::chrono::milliseconds batchWindow{20};  // how long a ready chunk waits for others to join its batch
+    size_t stageQueueDepth = 2;     // batches waiting between two stages before the earlier stage blocks
+    std::chrono::milliseconds deadline{0};      // from a chunk's close to the end of its decode, 0 disables
+    StalePolicy stalePolicy = StalePolicy::Merge;
+};
+
+// Several recorders sharing one set of models. Each stream keeps its own VAD, chunk queue and
+// partial-transcript state; the scheduler takes at most one chunk per stream per batch, round robin,
+// so a busy stream cannot starve the others.
+//
+// Batches then flow through four stages, each on its own thread and connected by bounded queues:
+// features (Python preprocessing) -> transcribe (Whisper) -> translate (transformer) -> output.
+// While the transformer works on one batch, Whisper already decodes the next, so throughput is set by
+// the slowest stage rather than by the sum of them. Every stage is a single FIFO, so the lines of a
+// stream keep their order; when a stage falls behind, the queues fill up and the recorders' overflow
+// policies take over.
+//
+// With a deadline set, a live session keeps up with current speech instead of transcribing every old word:
+// stale chunks are skipped or merged when taken, chunks that go stale between stages are not decoded, and
+// Whisper and transformer runs still in flight at the deadline are terminated. A final whose translation
+// was cut short is printed untranslated.
+//
+// A chunk that fails in any stage (a script error, an ONNX Runtime error) is reported on stderr and dropped;
+// the other chunks and streams carry on.
+class StreamScheduler {
+public:
+    StreamScheduler(SchedulerConfig config, const std::unique_ptr<Transcriber>& transcriber,
+                    const std::unique_ptr<Translator>& translator, const std::unique_ptr<Tokenizer>& tokenizer);
+
+    // An empty name prints without a label; a null output writes to std::cout.
+    void addStream(std::string name, std::unique_ptr<Recorder> recorder, std::unique_ptr<std::ostream> output = nullptr);
+
+    // Starts the recorders ahead of run(), e.g. while the models are still loading; their chunk queues hold
+    // the speech until then.
+    void startCapture();
+
+    // Starts every recorder not started yet and transcribes until shouldExit is set or all sources have ended,
+    // then finishes the chunks already taken and stops the recorders.
+    void run(const std::atomic<bool>& shouldExit);
+
+private:
+    struct Stream {
+        std::string name;
+        std::unique_ptr<Recorder> recorder;
+        std::unique_ptr<std::ostream> output;
+        std::vector<int64_t> partialIds;
+        uint64_t partialUtterance = 0;
+        // taken from the queue while merging stale chunks but not part of the merge; goes out next
+        AudioChunk carry;
+    };
+
+    // Filled in stage by stage.
+    struct PendingChunk {
+        Stream* stream;
+        AudioChunk chunk;
+        std::vector<float> features;
+        std::string transcript;
+        std::string translation;
+        size_t frames = 0;      // the chunk's length, kept after the feature stage releases its audio
+        DeadlineWatchdog::Clock::time_point deadline;
+        bool abandoned = false;     // given up or failed before it had a transcript, prints nothing
+        bool untranslated = false;  // the translation missed the deadline or failed
+    };
+    using Batch = std::vector<PendingChunk>;
+
+    SchedulerConfig config;
+    const std::unique_ptr<Transcriber>& transcriber;
+    const std::unique_ptr<Translator>& translator;
+    const std::unique_ptr<Tokenizer>& tokenizer;
+
+    std::vector<Stream> streams;
+    size_t nextStream = 0;
+    bool captureStarted = false;
+    DeadlineWatchdog watchdog;
+
+    bool waitReady(std::chrono::milliseconds timeout, const std::vector<bool>& taken);
+    void takeReady(Batch& batch, std::vector<bool>& taken);
+    AudioChunk takeChunk(Stream& stream, DeadlineWatchdog::Clock::time_point& deadline);
+    void mergeQueued(Stream& stream, AudioChunk& chunk);
+    Batch collectBatch();
+
+    void featureStage(StageQueue<Batch>& input, StageQueue<Batch>& output);
+    void transcribeStage(StageQueue<Batch>& input, StageQueue<Batch>& output);
+    void translateStage(StageQueue<Batch>& input, StageQueue<Batch>& output);
+    void outputStage(StageQueue<Batch>& input);
+    void writeResult(PendingChunk& pending);
+
+    std::vector<std::vector<int64_t>> decodeBatch(const std::vector<PendingChunk*>& batch,
+                                                  const std::vector<std::vector<int64_t>>& prefixes,
+                                                  const Ort::RunOptions& runOptions, const DeadlineWatchdog::Watch& watch);
+    std::ostream& outputOf(Stream& stream);
+    void reportStale(const Stream& stream, size_t frames, DeadlineWatchdog::Clock::time_point closedAt,
+                     const std::string& what);
+    void abandon(PendingChunk& pending, const std::string& what);
+};
+
+#endif //SCHEDULER_H
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <sstream>
+
+#include "session_scheduler.h"
+
+
+static thread_local Priority current_priority = Priority::Live;
+
+
+SessionScheduler::Inference::Inference(SessionScheduler* scheduler, Priority priority)
+        : scheduler(scheduler), priority(priority), waitingSince(std::chrono::steady_clock::now()) {}
+
+SessionScheduler::Inference::Inference(Inference&& other) noexcept
+        : scheduler(other.scheduler), priority(other.priority), waitingSince(other.waitingSince),
+          stepping(other.stepping) {
+    other.scheduler = nullptr;
+}
+
+SessionScheduler::Inference::~Inference() {
+    if (!scheduler) return;
+    {
+        std::lock_guard<std::mutex> lock(scheduler->mutex);
+        PriorityStats& stats = scheduler->stats_of(priority);
+        // never stepped, e.g. an empty batch or a decode that failed while leasing its state
+        if (!stepping) stats.waiting--;
+        if (stepping && priority == Priority::Batch) scheduler->batch_stepping--;
+        stats.running--;
+        stats.completed++;
+    }
+    scheduler->changed.notify_all();
+}
+
+void SessionScheduler::Inference::step() {
+    std::unique_lock<std::mutex> lock(scheduler->mutex);
+    PriorityStats& stats = scheduler->stats_of(priority);
+
+    if (priority == Priority::Live) {
+        if (!stepping) {
+            scheduler->record_wait(stats, waitingSince);
+            stats.waiting--;
+            stepping = true;
+        }
+        return;
+    }
+
+    // a batch step holds its slot until the next one asks, so the slot count bounds the runs in flight
+    if (stepping) {
+        scheduler->batch_stepping--;
+        scheduler->changed.notify_all();
+        waitingSince = std::chrono::steady_clock::now();
+        stats.waiting++;
+    }
+    auto blocked = [this]() {
+        return scheduler->live.running > 0 ||
+               (scheduler->batch_slots > 0 && scheduler->batch_stepping >= scheduler->batch_slots);
+    };
+    if (scheduler->live.running > 0) stats.preempted++;
+    scheduler->changed.wait(lock, [&]() { return !blocked(); });
+
+    scheduler->record_wait(stats, waitingSince);
+    stats.waiting--;
+    scheduler->batch_stepping++;
+    stepping = true;
+}
+
+SessionScheduler::Inference SessionScheduler::begin() {
+    const Priority priority = thread_priority();
+    std::lock_guard<std::mutex> lock(mutex);
+    PriorityStats& stats = stats_of(priority);
+    stats.running++;
+    stats.waiting++;
+    return Inference(this, priority);
+}
+
+void SessionScheduler::set_batch_slots(size_t slots) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch_slots = slots;
+    }
+    changed.notify_all();
+}
+
+PriorityStats SessionScheduler::stats(Priority priority) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return priority == Priority::Live ? live : batch;
+}
+
+std::string SessionScheduler::describe() const {
+    std::ostringstream out;
+    auto describe_class = [&out](const char* name, const PriorityStats& stats) {
+        const uint64_t waits = stats.completed + stats.running;
+        out << name << ": " << stats.waiting << " waiting, " << stats.running << " running, " << stats.completed
+            << " done, " << stats.preempted << " preempted, wait "
+            << static_cast<int>(waits > 0 ? stats.total_wait_ms / static_cast<double>(waits) : 0.0)
+            << " ms per decode, longest " << static_cast<int>(stats.max_wait_ms) << " ms";
+    };
+    std::lock_guard<std::mutex> lock(mutex);
+    describe_class("live", live);
+    out << "; ";
+    describe_class("batch", batch);
+    return out.str();
+}
+
+void SessionScheduler::record_wait(PriorityStats& stats, std::chrono::steady_clock::time_point since) {
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    stats.total_wait_ms += ms;
+    stats.max_wait_ms = std::max(stats.max_wait_ms, ms);
+}
+
+Priority thread_priority() {
+    return current_priority;
+}
+
+PriorityScope::PriorityScope(Priority priority) : previous(current_priority) {
+    current_priority = priority;
+}
+
+PriorityScope::~PriorityScope() {
+    current_priority = previous;
+}
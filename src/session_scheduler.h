@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef CPP_DEMO_SESSION_SCHEDULER_H
+#define CPP_DEMO_SESSION_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+
+enum class Priority {
+    Live,   // microphone and other real-time streams
+    Batch   // file jobs, run on whatever capacity live work leaves
+};
+
+struct PriorityStats {
+    size_t waiting = 0;         // inferences held before their first step or between two
+    size_t running = 0;         // inferences begun and not finished, waiting ones included
+    uint64_t completed = 0;
+    uint64_t preempted = 0;     // steps held back because live work was running
+    double total_wait_ms = 0.0;     // summed over every wait of every inference
+    double max_wait_ms = 0.0;       // longest single wait, for the first step or between two
+};
+
+// Admits the decode steps of every model session by priority class. A decode runs one session.Run per output
+// token; live inferences always step, while a batch inference waits before its next step as long as any live
+// inference is running, so live work preempts batch work at step granularity and a batch decode resumes where
+// it stopped. When no live work is running, batch work fills the idle cycles in micro-batches of batch_slots
+// concurrent steps, which bounds how much of the shared thread pool a newly arriving live chunk finds busy.
+class SessionScheduler {
+public:
+    // One decode, from once its state is leased to its last step.
+    class Inference {
+    public:
+        Inference(SessionScheduler* scheduler, Priority priority);
+        Inference(Inference&& other) noexcept;
+        Inference& operator=(Inference&&) = delete;
+        Inference(const Inference&) = delete;
+        ~Inference();
+
+        // Call before every session.Run of the decode; may block a batch inference.
+        void step();
+
+    private:
+        SessionScheduler* scheduler;
+        Priority priority;
+        std::chrono::steady_clock::time_point waitingSince;
+        bool stepping = false;
+    };
+
+    // 0 batch slots: no limit beyond the models' decode pools.
+    explicit SessionScheduler(size_t batch_slots = 0) : batch_slots(batch_slots) {}
+
+    // The class comes from the calling thread, see PriorityScope.
+    Inference begin();
+    void set_batch_slots(size_t slots);
+
+    PriorityStats stats(Priority priority) const;
+    // "live: 0 waiting, 1 running, 120 done, 0 preempted, wait 3 ms per decode, longest 40 ms; batch: ..."
+    std::string describe() const;
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    size_t batch_slots;
+    size_t batch_stepping = 0;
+    PriorityStats live;
+    PriorityStats batch;
+
+    PriorityStats& stats_of(Priority priority) { return priority == Priority::Live ? live : batch; }
+    void record_wait(PriorityStats& stats, std::chrono::steady_clock::time_point since);
+};
+
+// The priority class of the inferences the calling thread runs, Live unless a PriorityScope is active.
+Priority thread_priority();
+
+// Runs the current thread's inferences in another class until destroyed.
+class PriorityScope {
+public:
+    explicit PriorityScope(Priority priority);
+    ~PriorityScope();
+    PriorityScope(const PriorityScope&) = delete;
+    PriorityScope& operator=(const PriorityScope&) = delete;
+
+private:
+    Priority previous;
+};
+
+#endif //CPP_DEMO_SESSION_SCHEDULER_H
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef STAGE_QUEUE_H
+#define STAGE_QUEUE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+
+// Blocking FIFO between two pipeline stages. push() waits while the queue is full, so a slow stage holds back
+// the ones before it instead of letting work pile up; close() lets the consumer drain what is left, then stop.
+template <typename T>
+class StageQueue {
+public:
+    explicit StageQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+    StageQueue(const StageQueue&) = delete;
+    StageQueue& operator=(const StageQueue&) = delete;
+
+    // Returns false, dropping the item, once the queue is closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&]() { return items.size() < capacity || closed; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Returns false when the queue is closed and nothing is left.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&]() { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+#endif //STAGE_QUEUE_H
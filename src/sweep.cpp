@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "sweep.h"
+#include "pipeline.h"
+#include "utils.h"
+
+
+static const int SWEEP_REPEATS = 3;
+static const size_t MAX_WHISPER_SAMPLES = 30 * 16000;
+
+
+static std::string describe(const SessionTuning& tuning) {
+    // an inter-op count alone still gives the model its own intra-op pool, at ONNX Runtime's default size
+    std::string intra = tuning.intra_op_threads > 0 ? std::to_string(tuning.intra_op_threads)
+                        : tuning.inter_op_threads > 0 ? "default" : "shared";
+    std::string mode = tuning.parallel_execution ? "parallel inter=" + std::to_string(tuning.inter_op_threads) : "sequential";
+    return "intra=" + intra + " " + mode + " opt=" + optimization_name(tuning.optimization) +
+           " mem_pattern=" + (tuning.mem_pattern ? "on" : "off") + " arena=" + (tuning.cpu_arena ? "on" : "off");
+}
+
+// Median of a few runs after one warm-up; the first run plans memory and fills the arena.
+static double median_ms(const std::function<void()>& run) {
+    run();
+    std::vector<double> times;
+    for (int i = 0; i < SWEEP_REPEATS; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// 0 (the shared pool), then powers of two up to the core count, and the core count itself.
+static std::vector<int> thread_counts() {
+    const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> counts = {0};
+    for (int n = 1; n < cores; n *= 2) counts.push_back(n);
+    counts.push_back(cores);
+    return counts;
+}
+
+static SessionTuning descend(const std::string& model, SessionTuning best,
+                             const std::function<double(const SessionTuning&)>& measure, std::ostream& report) {
+    double best_ms = measure(best);
+    report << model << "  " << describe(best) << "  " << best_ms << " ms" << std::endl;
+
+    auto try_candidate = [&](const SessionTuning& candidate) {
+        double ms;
+        try {
+            ms = measure(candidate);
+        } catch (const std::exception& e) {
+            report << model << "  " << describe(candidate) << "  failed: " << e.what() << std::endl;
+            return;
+        }
+        report << model << "  " << describe(candidate) << "  " << ms << " ms" << std::endl;
+        if (ms < best_ms) {
+            best = candidate;
+            best_ms = ms;
+        }
+    };
+
+    for (int threads : thread_counts()) {
+        if (threads == best.intra_op_threads) continue;
+        SessionTuning candidate = best;
+        candidate.intra_op_threads = threads;
+        try_candidate(candidate);
+    }
+    // parallel execution needs an inter-op pool of its own: the shared one has a single thread
+    if (best.parallel_execution) {
+        SessionTuning candidate = best;
+        candidate.parallel_execution = false;
+        candidate.inter_op_threads = 0;
+        try_candidate(candidate);
+    }
+    for (int threads : thread_counts()) {
+        if (threads < 2 || (best.parallel_execution && threads == best.inter_op_threads)) continue;
+        SessionTuning candidate = best;
+        candidate.parallel_execution = true;
+        candidate.inter_op_threads = threads;
+        try_candidate(candidate);
+    }
+    for (GraphOptimizationLevel level : {ORT_ENABLE_BASIC, ORT_ENABLE_EXTENDED, ORT_ENABLE_ALL}) {
+        if (level == best.optimization) continue;
+        SessionTuning candidate = best;
+        candidate.optimization = level;
+        try_candidate(candidate);
+    }
+    {
+        SessionTuning candidate = best;
+        candidate.mem_pattern = !best.mem_pattern;
+        try_candidate(candidate);
+    }
+    {
+        SessionTuning candidate = best;
+        candidate.cpu_arena = !best.cpu_arena;
+        try_candidate(candidate);
+    }
+
+    report << model << "  fastest: " << describe(best) << "  " << best_ms << " ms" << std::endl;
+    return best;
+}
+
+TuningConfig run_sweep(const std::string& wav_path, const TuningConfig& base, std::ostream& report) {
+    TuningConfig tuned = base;
+    tuned.whisper.affinity.clear();
+    tuned.transformer.affinity.clear();
+
+    std::vector<float> audio = load_audio_data(wav_path);
+    if (audio.size() > MAX_WHISPER_SAMPLES) audio.resize(MAX_WHISPER_SAMPLES);
+    std::vector<float> features = extract_features(audio);
+
+    report << "sweep on " << wav_path << ": median of " << SWEEP_REPEATS << " runs after a warm-up" << std::endl;
+
+    tuned.whisper = descend("whisper", tuned.whisper, [&](const SessionTuning& tuning) {
+        Transcriber transcriber;
+        transcriber.load_model(transcription_model_path(), tuning);
+        return median_ms([&]() { transcriber.infer(features); });
+    }, report);
+
+    // the transformer is timed on the demo's own transcript
+    Transcriber transcriber;
+    transcriber.load_model(transcription_model_path(), tuned.whisper);
+    std::string transcript = decode_tokens(transcriber.infer(features));
+    Tokenizer tokenizer("no", "en");
+    std::vector<int64_t> encoder_input = tokenizer.convert_token_to_id(tokenizer.preprocessing(transcript));
+
+    tuned.transformer = descend("transformer", tuned.transformer, [&](const SessionTuning& tuning) {
+        Translator translator;
+        translator.load_model(translation_model_path(), tuning);
+        return median_ms([&]() { translator.infer(encoder_input); });
+    }, report);
+
+    report << "\n# fastest settings, for --tuning\n"
+           << "[runtime]\n"
+           << "intra_op_threads = " << tuned.runtime.intra_op_threads << "\n"
+           << "inter_op_threads = " << tuned.runtime.inter_op_threads << "\n\n"
+           << format_tuning("whisper", tuned.whisper) << "\n"
+           << format_tuning("transformer", tuned.transformer) << std::flush;
+    return tuned;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#ifndef CPP_DEMO_SWEEP_H
+#define CPP_DEMO_SWEEP_H
+
+#include <ostream>
+#include <string>
+
+#include "tuning.h"
+
+
+// Benchmarks session settings for Whisper and then the transformer on the first 30 s of wav_path and reports
+// every measurement plus the fastest settings as a tuning file. Settings are tuned one at a time, keeping the
+// best value of each before moving to the next; a full grid takes hours on a many-core machine.
+// Starts from base, minus any affinity, and returns the tuned config. Needs the RuntimeContext and Python.
+TuningConfig run_sweep(const std::string& wav_path, const TuningConfig& base, std::ostream& report);
+
+#endif //CPP_DEMO_SWEEP_H
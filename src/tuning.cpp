@@ -0,0 +1,134 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "tuning.h"
+
+
+static std::string trim(const std::string& text) {
+    const char* space = " \t\r";
+    size_t begin = text.find_first_not_of(space);
+    if (begin == std::string::npos) return "";
+    return text.substr(begin, text.find_last_not_of(space) - begin + 1);
+}
+
+static int parse_count(const std::string& name, const std::string& value) {
+    try {
+        size_t used = 0;
+        int result = std::stoi(value, &used);
+        if (used == value.size() && result >= 0) return result;
+    } catch (const std::logic_error&) {}
+    throw std::invalid_argument("Invalid value for " + name + ": " + value);
+}
+
+static bool parse_switch(const std::string& name, const std::string& value) {
+    if (value == "true" || value == "on" || value == "1") return true;
+    if (value == "false" || value == "off" || value == "0") return false;
+    throw std::invalid_argument("Invalid value for " + name + ": " + value);
+}
+
+static void set_session_value(SessionTuning& tuning, const std::string& name, const std::string& key,
+                              const std::string& value) {
+    if (key == "intra_op_threads") {
+        tuning.intra_op_threads = parse_count(name, value);
+    } else if (key == "inter_op_threads") {
+        tuning.inter_op_threads = parse_count(name, value);
+    } else if (key == "execution_mode") {
+        if (value != "sequential" && value != "parallel") {
+            throw std::invalid_argument("Invalid value for " + name + ": " + value);
+        }
+        tuning.parallel_execution = value == "parallel";
+    } else if (key == "optimization") {
+        bool known = false;
+        for (GraphOptimizationLevel level : {ORT_DISABLE_ALL, ORT_ENABLE_BASIC, ORT_ENABLE_EXTENDED, ORT_ENABLE_ALL}) {
+            if (value != optimization_name(level)) continue;
+            tuning.optimization = level;
+            known = true;
+        }
+        if (!known) throw std::invalid_argument("Invalid value for " + name + ": " + value);
+    } else if (key == "mem_pattern") {
+        tuning.mem_pattern = parse_switch(name, value);
+    } else if (key == "cpu_arena") {
+        tuning.cpu_arena = parse_switch(name, value);
+    } else if (key == "affinity") {
+        tuning.affinity = value;
+    } else {
+        throw std::invalid_argument("Unknown tuning setting: " + name);
+    }
+}
+
+void set_tuning_value(TuningConfig& config, const std::string& name, const std::string& value) {
+    size_t dot = name.find('.');
+    if (dot == std::string::npos) {
+        throw std::invalid_argument("Tuning settings are <section>.<key>: " + name);
+    }
+    const std::string section = name.substr(0, dot);
+    const std::string key = name.substr(dot + 1);
+
+    if (section == "runtime") {
+        if (key == "intra_op_threads") config.runtime.intra_op_threads = parse_count(name, value);
+        else if (key == "inter_op_threads") config.runtime.inter_op_threads = parse_count(name, value);
+        else throw std::invalid_argument("Unknown tuning setting: " + name);
+    } else if (section == "whisper") {
+        set_session_value(config.whisper, name, key, value);
+    } else if (section == "transformer") {
+        set_session_value(config.transformer, name, key, value);
+    } else if (section == "vad") {
+        set_session_value(config.vad, name, key, value);
+    } else {
+        throw std::invalid_argument("Unknown tuning section: " + section);
+    }
+}
+
+TuningConfig load_tuning_file(const std::string& path, TuningConfig config) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open tuning file: " + path);
+    }
+
+    std::string section;
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        if (line.front() == '[' && line.back() == ']') {
+            section = trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos || section.empty()) {
+            throw std::invalid_argument(path + ":" + std::to_string(number) + ": expected [section] or key = value");
+        }
+        try {
+            set_tuning_value(config, section + "." + trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+        } catch (const std::invalid_argument& e) {
+            throw std::invalid_argument(path + ":" + std::to_string(number) + ": " + e.what());
+        }
+    }
+    return config;
+}
+
+const char* optimization_name(GraphOptimizationLevel optimization) {
+    switch (optimization) {
+        case ORT_DISABLE_ALL: return "disable";
+        case ORT_ENABLE_BASIC: return "basic";
+        case ORT_ENABLE_EXTENDED: return "extended";
+        default: return "all";
+    }
+}
+
+std::string format_tuning(const std::string& section, const SessionTuning& tuning) {
+    std::ostringstream out;
+    out << "[" << section << "]\n"
+        << "intra_op_threads = " << tuning.intra_op_threads << "\n"
+        << "inter_op_threads = " << tuning.inter_op_threads << "\n"
+        << "execution_mode = " << (tuning.parallel_execution ? "parallel" : "sequential") << "\n"
+        << "optimization = " << optimization_name(tuning.optimization) << "\n"
+        << "mem_pattern = " << (tuning.mem_pattern ? "on" : "off") << "\n"
+        << "cpu_arena = " << (tuning.cpu_arena ? "on" : "off") << "\n";
+    if (!tuning.affinity.empty()) out << "affinity = " << tuning.affinity << "\n";
+    return out.str();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef CPP_DEMO_TUNING_H
+#define CPP_DEMO_TUNING_H
+
+#include <string>
+
+#include "runtime_context.h"
+
+
+struct TuningConfig {
+    RuntimeConfig runtime;
+    SessionTuning whisper;
+    SessionTuning transformer;
+    SessionTuning vad;
+};
+
+// name is "<section>.<key>". Sections: runtime (intra_op_threads, inter_op_threads) and whisper, transformer,
+// vad (intra_op_threads, inter_op_threads, execution_mode sequential|parallel,
+// optimization disable|basic|extended|all, mem_pattern, cpu_arena, affinity).
+// Throws std::invalid_argument for unknown names and bad values.
+void set_tuning_value(TuningConfig& config, const std::string& name, const std::string& value);
+
+// An INI-style file: "[section]" headers, then "key = value" lines; '#' starts a comment.
+// Values are applied on top of config. Throws std::runtime_error if the file cannot be read.
+TuningConfig load_tuning_file(const std::string& path, TuningConfig config = {});
+
+// disable, basic, extended or all: the optimization values of the file format above.
+const char* optimization_name(GraphOptimizationLevel optimization);
+
+// The section in the file format above, so a sweep result can be pasted into a tuning file.
+std::string format_tuning(const std::string& section, const SessionTuning& tuning);
+
+#endif //CPP_DEMO_TUNING_H
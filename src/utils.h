@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include "portaudio.h"
+#include "resampler.h"
 
 
 
@@ -10,12 +11,9 @@ void softmax(std::vector<float>& input);
 
 size_t argsort_max(const std::vector<float>& output_probs);
 
-std::variant<std::unordered_map<int, std::string>,std::unordered_map<std::string, int>>
-load_vocab(const std::string& file_path, bool reverse=false);
-
 std::string read_file_string(const std::string& filePath);
 
-std::vector<float> load_audio_data(const std::string& filename);
+std::vector<float> load_audio_data(const std::string& filename, ResamplerConfig resampler = {});
 
 bool endsWith(const std::string& str, const std::string& suffix="@@");
 
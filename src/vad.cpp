@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstring>
+
+#include "vad.h"
+
+
+static const int64_t VAD_SAMPLE_RATE = 16000;
+static const size_t STATE_WINDOW_SIZE = 512;
+static const size_t STATE_CONTEXT_SIZE = 64;
+// per-buffer smoothing of the noise floor: quiet rise between utterances, much slower during speech
+static constexpr float FLOOR_RISE_SILENCE = 0.02f;
+static constexpr float FLOOR_RISE_SPEECH = 0.001f;
+static constexpr float FLOOR_FALL = 0.5f;
+
+
+static float meanEnergy(const std::vector<float>& buffer) {
+    float energy = 0.0f;
+    for (float sample : buffer) {
+        energy += sample * sample;
+    }
+    return energy / static_cast<float>(buffer.size());
+}
+
+
+bool EnergyVad::isSpeech(const std::vector<float>& buffer) {
+    float energy = meanEnergy(buffer);
+//    std::cout << energy << " ";
+    return energy > threshold;
+}
+
+bool AdaptiveEnergyVad::isSpeech(const std::vector<float>& buffer) {
+    float energy = meanEnergy(buffer);
+
+    if (noiseFloor <= 0.0f) {
+        // first buffer after a reset only seeds the floor
+        noiseFloor = std::max(energy, minFloor);
+        return false;
+    }
+
+    if (speaking) {
+        speaking = energy > noiseFloor * offRatio;
+    } else {
+        speaking = energy > noiseFloor * onRatio;
+    }
+
+    if (energy < noiseFloor) {
+        noiseFloor += FLOOR_FALL * (energy - noiseFloor);
+    } else {
+        noiseFloor += (speaking ? FLOOR_RISE_SPEECH : FLOOR_RISE_SILENCE) * (energy - noiseFloor);
+    }
+    noiseFloor = std::max(noiseFloor, minFloor);
+
+    return speaking;
+}
+
+void AdaptiveEnergyVad::reset() {
+    noiseFloor = 0.0f;
+    speaking = false;
+}
+
+OnnxVad::OnnxVad(const std::string& model_path, float threshold, const SessionTuning& tuning)
+        : runOptions(Ort::RunOptions()), threshold(threshold) {
+    // every stream has its own detector; the sessions share the global pool rather than a thread each
+    RuntimeContext& runtime = RuntimeContext::instance();
+    session = runtime.create_session(model_path, tuning);
+    Ort::AllocatorWithDefaultOptions ort_alloc;
+
+    for (size_t i = 0; i < session.GetInputCount(); i++) {
+        std::string name = session.GetInputNameAllocated(i, ort_alloc).get();
+        if (name == "state" || name == "h") {
+            stateShape = session.GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape();
+            for (auto& dim : stateShape) dim = std::max<int64_t>(dim, 1);
+        }
+        if (name == "state") combinedState = true;
+        input_names.push_back(name);
+    }
+    for (size_t i = 0; i < session.GetOutputCount(); i++) {
+        output_names.emplace_back(session.GetOutputNameAllocated(i, ort_alloc).get());
+    }
+    if (stateShape.empty()) {
+        throw std::runtime_error("VAD model has no recurrent state input: " + model_path);
+    }
+
+    if (combinedState) {
+        windowSize = STATE_WINDOW_SIZE;
+        contextSize = STATE_CONTEXT_SIZE;
+    }
+    reset();
+}
+
+void OnnxVad::reset() {
+    size_t stateSize = 1;
+    for (auto dim : stateShape) stateSize *= static_cast<size_t>(dim);
+    state.assign(stateSize, 0.0f);
+    cellState.assign(combinedState ? 0 : stateSize, 0.0f);
+    context.assign(contextSize, 0.0f);
+}
+
+bool OnnxVad::isSpeech(const std::vector<float>& buffer) {
+    if (windowSize == 0) {
+        return runWindow(buffer.data(), buffer.size()) > threshold;
+    }
+
+    // any window above threshold marks the whole buffer as speech, but every window
+    // still runs so the recurrent state sees all of the audio
+    float probability = 0.0f;
+    for (size_t offset = 0; offset < buffer.size(); offset += windowSize) {
+        size_t count = std::min(windowSize, buffer.size() - offset);
+        probability = std::max(probability, runWindow(buffer.data() + offset, count));
+    }
+    return probability > threshold;
+}
+
+float OnnxVad::runWindow(const float* samples, size_t count) {
+    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+
+    size_t frameSize = contextSize + std::max(windowSize, count);
+    window.assign(frameSize, 0.0f);
+    std::copy(context.begin(), context.end(), window.begin());
+    std::copy(samples, samples + count, window.begin() + static_cast<std::ptrdiff_t>(contextSize));
+
+    int64_t sampleRate = VAD_SAMPLE_RATE;
+    std::vector<int64_t> audioShape = {1, static_cast<int64_t>(frameSize)};
+    std::vector<int64_t> scalarShape;
+
+    std::vector<const char*> input_ptrs;
+    std::vector<Ort::Value> input_tensors;
+    for (const auto& name : input_names) {
+        input_ptrs.push_back(name.c_str());
+        if (name == "input") {
+            input_tensors.emplace_back(Ort::Value::CreateTensor<float>(
+                    memory_info, window.data(), window.size(), audioShape.data(), audioShape.size()));
+        } else if (name == "sr") {
+            input_tensors.emplace_back(Ort::Value::CreateTensor<int64_t>(
+                    memory_info, &sampleRate, 1, scalarShape.data(), scalarShape.size()));
+        } else if (name == "c") {
+            input_tensors.emplace_back(Ort::Value::CreateTensor<float>(
+                    memory_info, cellState.data(), cellState.size(), stateShape.data(), stateShape.size()));
+        } else {
+            input_tensors.emplace_back(Ort::Value::CreateTensor<float>(
+                    memory_info, state.data(), state.size(), stateShape.data(), stateShape.size()));
+        }
+    }
+
+    std::vector<const char*> output_ptrs;
+    for (const auto& name : output_names) output_ptrs.push_back(name.c_str());
+
+    std::vector<Ort::Value> output_tensors = session.Run(runOptions,
+                                                         input_ptrs.data(), input_tensors.data(), input_tensors.size(),
+                                                         output_ptrs.data(), output_ptrs.size());
+
+    // outputs are (probability, state) or (probability, h, c)
+    float probability = output_tensors[0].GetTensorMutableData<float>()[0];
+    const float* newState = output_tensors[1].GetTensorMutableData<float>();
+    std::copy(newState, newState + state.size(), state.begin());
+    if (!combinedState && output_tensors.size() > 2) {
+        const float* newCell = output_tensors[2].GetTensorMutableData<float>();
+        std::copy(newCell, newCell + cellState.size(), cellState.begin());
+    }
+
+    if (contextSize > 0) {
+        std::copy(window.end() - static_cast<std::ptrdiff_t>(contextSize), window.end(), context.begin());
+    }
+    return probability;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef VAD_H
+#define VAD_H
+
+#include <string>
+#include <vector>
+
+#include "onnxruntime_cxx_api.h"
+#include "runtime_context.h"
+
+
+// Decides per capture buffer whether it contains speech. Implementations may keep state
+// across buffers; reset() is called whenever a new recording starts.
+class VoiceActivityDetector {
+public:
+    virtual ~VoiceActivityDetector() = default;
+    virtual bool isSpeech(const std::vector<float>& buffer) = 0;
+    virtual void reset() {}
+};
+
+// Mean energy against a fixed threshold. Cheap, but fires on any loud noise.
+class EnergyVad : public VoiceActivityDetector {
+public:
+    explicit EnergyVad(float threshold = 3.0e-5f) : threshold(threshold) {}
+    bool isSpeech(const std::vector<float>& buffer) override;
+
+private:
+    float threshold;
+};
+
+// Energy against a tracked noise floor, with separate onset and release thresholds so that
+// quiet speakers still trigger and loud rooms do not chatter around a single threshold.
+// The floor follows drops immediately and rises slowly, so speech does not pull it up.
+class AdaptiveEnergyVad : public VoiceActivityDetector {
+public:
+    explicit AdaptiveEnergyVad(float onRatio = 4.0f, float offRatio = 2.0f, float minFloor = 1.0e-7f)
+            : onRatio(onRatio), offRatio(offRatio), minFloor(minFloor) {}
+    bool isSpeech(const std::vector<float>& buffer) override;
+    void reset() override;
+
+private:
+    float onRatio;
+    float offRatio;
+    float minFloor;
+    float noiseFloor = 0.0f;
+    bool speaking = false;
+};
+
+// Small recurrent speech/non-speech model (Silero VAD style) run through ONNX Runtime.
+// Supports both export layouts: a single "state" tensor with 64 samples of left context
+// per 512-sample window, or separate "h"/"c" tensors fed the whole buffer at once.
+// The recurrent state is carried from one buffer to the next.
+class OnnxVad : public VoiceActivityDetector {
+public:
+    explicit OnnxVad(const std::string& model_path, float threshold = 0.5f, const SessionTuning& tuning = {});
+    bool isSpeech(const std::vector<float>& buffer) override;
+    void reset() override;
+
+private:
+    Ort::RunOptions runOptions;
+    Ort::Session session{nullptr};
+
+    std::vector<std::string> input_names;
+    std::vector<std::string> output_names;
+
+    float threshold;
+    bool combinedState = false;
+    size_t windowSize = 0;
+    size_t contextSize = 0;
+
+    std::vector<int64_t> stateShape;
+    std::vector<float> state;
+    std::vector<float> cellState;
+    std::vector<float> context;
+    std::vector<float> window;
+
+    float runWindow(const float* samples, size_t count);
+};
+
+#endif //VAD_H
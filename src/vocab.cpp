@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unistd.h>
+
+#include "vocab.h"
+#include "utils.h"
+
+
+static constexpr char VOCAB_MAGIC[8] = {'C', 'D', 'V', 'O', 'C', 'A', 'B', '\0'};
+static constexpr uint32_t VOCAB_VERSION = 1;
+static constexpr uint32_t KEYS_PER_BUCKET = 4;
+static constexpr uint32_t MAX_SEED = 1u << 24;
+
+struct VocabHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t id_count;
+    uint32_t token_count;
+    uint32_t bucket_count;
+    uint32_t slot_count;
+    uint32_t arena_size;
+};
+
+static uint64_t hash_token(std::string_view token, uint32_t seed) {
+    // FNV-1a with a seeded basis, finished with the murmur3 avalanche step
+    uint64_t h = 14695981039346656037ULL ^ (static_cast<uint64_t>(seed) * 0x9E3779B97F4A7C15ULL);
+    for (unsigned char c : token) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static size_t blob_size(const VocabHeader& header) {
+    return sizeof(VocabHeader)
+           + sizeof(uint32_t) * (static_cast<size_t>(header.id_count) + 1)
+           + sizeof(uint32_t) * header.bucket_count
+           + sizeof(int32_t) * header.slot_count
+           + header.arena_size;
+}
+
+
+Vocab Vocab::load(const std::string& text_path) {
+    namespace fs = std::filesystem;
+    std::string binary_path = binary_path_for(text_path);
+
+    std::error_code ec;
+    if (fs::exists(binary_path, ec)) {
+        bool up_to_date = !fs::exists(text_path, ec) ||
+                          fs::last_write_time(binary_path, ec) >= fs::last_write_time(text_path, ec);
+        if (up_to_date) {
+            try {
+                return from_binary(binary_path);
+            } catch (const std::runtime_error& e) {
+                std::cerr << "Ignoring compiled vocabulary " << binary_path << ": " << e.what() << std::endl;
+            }
+        }
+    }
+
+    Vocab vocab = from_text(text_path);
+    try {
+        vocab.save_binary(binary_path);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Could not write compiled vocabulary " << binary_path << ": " << e.what() << std::endl;
+    }
+    return vocab;
+}
+
+std::string Vocab::binary_path_for(const std::string& text_path) {
+    return std::filesystem::path(text_path).replace_extension(".vocab").string();
+}
+
+Vocab Vocab::from_text(const std::string& text_path) {
+    const std::string text = read_file_string(text_path);
+
+    // "token\tid" per line; later lines win, as they did with the unordered_map tables
+    std::vector<std::string_view> id_to_token;
+    std::unordered_map<std::string_view, int> token_to_id;
+
+    size_t line_begin = 0;
+    while (line_begin < text.size()) {
+        size_t line_end = text.find('\n', line_begin);
+        if (line_end == std::string::npos) line_end = text.size();
+        std::string_view line(text.data() + line_begin, line_end - line_begin);
+        line_begin = line_end + 1;
+
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        size_t tab = line.find('\t');
+        if (tab == std::string_view::npos) continue;
+
+        int index = 0;
+        const char* number_begin = line.data() + tab + 1;
+        auto [ptr, err] = std::from_chars(number_begin, line.data() + line.size(), index);
+        if (err != std::errc() || ptr == number_begin || index < 0) continue;
+
+        std::string_view word = line.substr(0, tab);
+        if (static_cast<size_t>(index) >= id_to_token.size()) id_to_token.resize(index + 1);
+        id_to_token[index] = word;
+        token_to_id[word] = index;
+    }
+
+    // reverse entries are verified against the forward table on lookup, so only keep consistent ones
+    std::vector<std::pair<std::string_view, int>> keys;
+    keys.reserve(token_to_id.size());
+    for (const auto& [word, index] : token_to_id) {
+        if (id_to_token[index] == word) keys.emplace_back(word, index);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    VocabHeader header{};
+    std::memcpy(header.magic, VOCAB_MAGIC, sizeof(VOCAB_MAGIC));
+    header.version = VOCAB_VERSION;
+    header.id_count = static_cast<uint32_t>(id_to_token.size());
+    header.token_count = static_cast<uint32_t>(keys.size());
+    header.bucket_count = std::max<uint32_t>(1, header.token_count / KEYS_PER_BUCKET);
+    header.slot_count = std::max<uint32_t>(1, header.token_count + header.token_count / 4);
+    for (const auto& word : id_to_token) header.arena_size += static_cast<uint32_t>(word.size());
+
+    std::vector<uint32_t> offsets(header.id_count + 1, 0);
+    for (size_t i = 0; i < id_to_token.size(); ++i)
+        offsets[i + 1] = offsets[i] + static_cast<uint32_t>(id_to_token[i].size());
+
+    // hash and displace: place the largest buckets first, searching a seed per bucket
+    // that sends all of its keys to distinct free slots
+    std::vector<std::vector<uint32_t>> buckets(header.bucket_count);
+    for (uint32_t i = 0; i < keys.size(); ++i)
+        buckets[hash_token(keys[i].first, 0) % header.bucket_count].push_back(i);
+
+    std::vector<uint32_t> bucket_order(header.bucket_count);
+    for (uint32_t b = 0; b < header.bucket_count; ++b) bucket_order[b] = b;
+    std::stable_sort(bucket_order.begin(), bucket_order.end(), [&buckets](uint32_t a, uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<uint32_t> seeds(header.bucket_count, 0);
+    std::vector<int32_t> slots(header.slot_count, -1);
+    std::vector<uint32_t> candidate;
+    for (uint32_t b : bucket_order) {
+        const auto& bucket = buckets[b];
+        if (bucket.empty()) break;
+
+        uint32_t seed = 1;
+        for (; seed < MAX_SEED; ++seed) {
+            candidate.clear();
+            bool placed = true;
+            for (uint32_t key : bucket) {
+                auto slot = static_cast<uint32_t>(hash_token(keys[key].first, seed) % header.slot_count);
+                if (slots[slot] != -1 || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                    placed = false;
+                    break;
+                }
+                candidate.push_back(slot);
+            }
+            if (placed) break;
+        }
+        if (seed == MAX_SEED) {
+            throw std::runtime_error("Could not build perfect hash for " + text_path);
+        }
+
+        seeds[b] = seed;
+        for (size_t i = 0; i < bucket.size(); ++i)
+            slots[candidate[i]] = keys[bucket[i]].second;
+    }
+
+    Vocab vocab;
+    vocab.buffer.resize(blob_size(header));
+    char* out = vocab.buffer.data();
+    auto append = [&out](const void* src, size_t bytes) {
+        if (bytes > 0) std::memcpy(out, src, bytes);
+        out += bytes;
+    };
+    append(&header, sizeof(header));
+    append(offsets.data(), offsets.size() * sizeof(uint32_t));
+    append(seeds.data(), seeds.size() * sizeof(uint32_t));
+    append(slots.data(), slots.size() * sizeof(int32_t));
+    for (const auto& word : id_to_token) append(word.data(), word.size());
+
+    vocab.attach(vocab.buffer.data(), vocab.buffer.size());
+    return vocab;
+}
+
+Vocab Vocab::from_binary(const std::string& binary_path) {
+    Vocab vocab;
+    vocab.mapping = MappedFile(binary_path);
+    vocab.attach(vocab.mapping.data(), vocab.mapping.size());
+    return vocab;
+}
+
+void Vocab::save_binary(const std::string& binary_path) const {
+    const char* data = buffer.empty() ? mapping.data() : buffer.data();
+    size_t size = buffer.empty() ? mapping.size() : buffer.size();
+
+    // write under a private name next to the target and rename, so a concurrent start never maps
+    // a half-written file and two starts never write into the same one
+    std::string temp_path = binary_path + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file");
+        }
+        file.write(data, static_cast<std::streamsize>(size));
+        if (!file) {
+            throw std::runtime_error("Could not write file");
+        }
+    }
+    if (std::rename(temp_path.c_str(), binary_path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Could not rename file");
+    }
+}
+
+void Vocab::attach(const char* data, size_t size) {
+    VocabHeader header{};
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Vocabulary file is truncated");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, VOCAB_MAGIC, sizeof(VOCAB_MAGIC)) != 0 || header.version != VOCAB_VERSION) {
+        throw std::runtime_error("Unsupported vocabulary file format");
+    }
+    if (header.bucket_count == 0 || header.slot_count == 0 || size != blob_size(header)) {
+        throw std::runtime_error("Vocabulary file is corrupt");
+    }
+
+    id_count = header.id_count;
+    token_count = header.token_count;
+    bucket_count = header.bucket_count;
+    slot_count = header.slot_count;
+
+    const char* p = data + sizeof(header);
+    offsets = reinterpret_cast<const uint32_t*>(p);
+    p += sizeof(uint32_t) * (static_cast<size_t>(id_count) + 1);
+    seeds = reinterpret_cast<const uint32_t*>(p);
+    p += sizeof(uint32_t) * bucket_count;
+    slots = reinterpret_cast<const int32_t*>(p);
+    p += sizeof(int32_t) * slot_count;
+    arena = p;
+
+    // lookups index the arena and the offsets without bounds checks, so a damaged file must not get this far
+    bool valid = offsets[0] == 0 && offsets[id_count] == header.arena_size;
+    for (uint32_t i = 0; valid && i < id_count; ++i)
+        valid = offsets[i] <= offsets[i + 1];
+    for (uint32_t i = 0; valid && i < slot_count; ++i)
+        valid = slots[i] == -1 || (slots[i] >= 0 && static_cast<uint32_t>(slots[i]) < id_count);
+    if (!valid) {
+        throw std::runtime_error("Vocabulary file is corrupt");
+    }
+}
+
+std::string_view Vocab::token(int id) const {
+    if (id < 0 || static_cast<uint32_t>(id) >= id_count || offsets[id] == offsets[id + 1]) {
+        throw std::out_of_range("Unknown token id: " + std::to_string(id));
+    }
+    return {arena + offsets[id], offsets[id + 1] - offsets[id]};
+}
+
+int Vocab::id(std::string_view token) const {
+    int index = find(token);
+    if (index < 0) {
+        throw std::out_of_range("Unknown token: " + std::string(token));
+    }
+    return index;
+}
+
+bool Vocab::contains(std::string_view token) const {
+    return find(token) >= 0;
+}
+
+int Vocab::find(std::string_view token) const {
+    if (token_count == 0) return -1;
+
+    uint32_t seed = seeds[hash_token(token, 0) % bucket_count];
+    int32_t index = slots[hash_token(token, seed) % slot_count];
+    if (index < 0) return -1;
+
+    // keys outside the table hash to arbitrary slots, so confirm against the arena
+    std::string_view stored(arena + offsets[index], offsets[index + 1] - offsets[index]);
+    return stored == token ? index : -1;
+}
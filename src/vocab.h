@@ -0,0 +1,63 @@
+#pragma once
+
+#ifndef CPP_DEMO_VOCAB_H
+#define CPP_DEMO_VOCAB_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+
+
+// Flat token <-> id table. All tokens live in one contiguous arena, id lookup goes through
+// an offset array and reverse lookup through a hash-and-displace perfect hash.
+//
+// The in-memory layout is exactly the compiled ".vocab" file, so a compiled vocabulary is
+// used straight from its memory mapping without any parsing:
+//
+//   VocabHeader
+//   uint32_t offsets[id_count + 1]    token i is arena[offsets[i], offsets[i + 1])
+//   uint32_t seeds[bucket_count]      per-bucket displacement seed
+//   int32_t  slots[slot_count]        slot -> id, -1 if the slot is free
+//   char     arena[arena_size]
+class Vocab {
+public:
+    Vocab() = default;
+
+    // Loads "<stem>.vocab" next to the text vocabulary if it is up to date,
+    // otherwise parses the text file and tries to write the compiled file for the next start.
+    static Vocab load(const std::string& text_path);
+    static Vocab from_text(const std::string& text_path);
+    static Vocab from_binary(const std::string& binary_path);
+    static std::string binary_path_for(const std::string& text_path);
+
+    void save_binary(const std::string& binary_path) const;
+
+    // Both lookups throw std::out_of_range for unknown entries, like unordered_map::at.
+    std::string_view token(int id) const;
+    int id(std::string_view token) const;
+    bool contains(std::string_view token) const;
+
+    size_t size() const { return token_count; }
+
+private:
+    MappedFile mapping;
+    std::vector<char> buffer;
+
+    uint32_t id_count = 0;
+    uint32_t token_count = 0;
+    uint32_t bucket_count = 0;
+    uint32_t slot_count = 0;
+
+    const uint32_t* offsets = nullptr;
+    const uint32_t* seeds = nullptr;
+    const int32_t* slots = nullptr;
+    const char* arena = nullptr;
+
+    void attach(const char* data, size_t size);
+    int find(std::string_view token) const;
+};
+
+#endif //CPP_DEMO_VOCAB_H
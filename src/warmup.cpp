@@ -0,0 +1,58 @@
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+#include "warmup.h"
+#include "pipeline.h"
+
+
+static const int WARMUP_SAMPLES = 16000;
+static const std::vector<int64_t> WARMUP_TOKENS = { 50257 };
+static const std::string WARMUP_SENTENCE = "Dette er en test.";
+
+
+static float time_ms(const std::function<void()>& run) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static WarmupStage measure(const std::string& name, const std::function<void()>& run) {
+    WarmupStage stage;
+    stage.name = name;
+    stage.cold_ms = time_ms(run);
+    stage.warm_ms = time_ms(run);
+    return stage;
+}
+
+// a quiet tone, so the energy of the features is not all zero
+static std::vector<float> synthetic_chunk() {
+    constexpr float pi = 3.14159265358979f;
+    std::vector<float> chunk(WARMUP_SAMPLES);
+    for (size_t i = 0; i < chunk.size(); ++i)
+        chunk[i] = 0.05f * std::sin(2.0f * pi * 220.0f * static_cast<float>(i) / 16000.0f);
+    return chunk;
+}
+
+std::vector<WarmupStage> warm_up(const std::unique_ptr<Transcriber>& transcriber,
+                                 const std::unique_ptr<Translator>& translator,
+                                 const std::unique_ptr<Tokenizer>& tokenizer, size_t max_batch) {
+    const std::vector<float> chunk = synthetic_chunk();
+    std::vector<WarmupStage> stages;
+
+    stages.push_back(measure("features", [&]() { extract_features(chunk); }));
+    stages.push_back(measure("whisper", [&]() { transcriber->warm_up(1); }));
+    if (max_batch > 1 && transcriber->supports_batch())
+        stages.push_back(measure("whisper x" + std::to_string(max_batch), [&]() { transcriber->warm_up(max_batch); }));
+    stages.push_back(measure("decode", [&]() { decode_tokens(WARMUP_TOKENS); }));
+    stages.push_back(measure("transformer", [&]() { translator->warm_up(); }));
+    stages.push_back(measure("translation", [&]() { translate(WARMUP_SENTENCE, translator, tokenizer); }));
+    return stages;
+}
+
+void report_warmup(const std::vector<WarmupStage>& stages, std::ostream& out) {
+    for (const auto& stage : stages) {
+        out << "warm-up " << stage.name << ": cold " << static_cast<int>(stage.cold_ms) << " ms, warm "
+            << static_cast<int>(stage.warm_ms) << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef CPP_DEMO_WARMUP_H
+#define CPP_DEMO_WARMUP_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "models.h"
+
+
+struct WarmupStage {
+    std::string name;
+    float cold_ms = 0.0f;
+    float warm_ms = 0.0f;
+};
+
+// Runs a synthetic chunk through every stage twice before any real audio: feature extraction and token
+// decoding (Python imports numpy and transformers on first use), both models at their longest decode for
+// max_batch inputs, and one sentence through translation. The first pass pays the one-off costs, the second
+// shows what a user will see. Needs the models and Python.
+std::vector<WarmupStage> warm_up(const std::unique_ptr<Transcriber>& transcriber,
+                                 const std::unique_ptr<Translator>& translator,
+                                 const std::unique_ptr<Tokenizer>& tokenizer, size_t max_batch);
+
+void report_warmup(const std::vector<WarmupStage>& stages, std::ostream& out);
+
+#endif //CPP_DEMO_WARMUP_H
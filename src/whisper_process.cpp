@@ -7,37 +7,56 @@ PythonEnvironment::PythonEnvironment() {
     if (_import_array() < 0) {
         throw std::runtime_error("NumPy initialization failed");
     }
+
+    PyRun_SimpleString(
+            "import sys\n"
+            "class NullWriter:\n"
+            "    def write(self, msg): pass\n"
+            "    def flush(self): pass\n"
+            "sys.stdout = NullWriter()\n"
+            "sys.stderr = NullWriter()\n"
+    );
+
+    main_thread_state = PyEval_SaveThread();
 }
 
 PythonEnvironment::~PythonEnvironment() {
+    PyEval_RestoreThread(main_thread_state);
     Py_Finalize();
 }
 
+// Runs the script with input bound to input_name and returns a new reference to output_name, or nullptr.
+static PyObject* run_script(const std::string& python_script, const char* input_name, PyObject* input,
+                            const char* output_name) {
+    PyObject* globals = PyDict_New();
+    PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+    PyDict_SetItemString(globals, input_name, input);
+
+    PyObject* result = nullptr;
+    PyObject* run = PyRun_String(python_script.c_str(), Py_file_input, globals, globals);
+    if (run) {
+        result = PyDict_GetItemString(globals, output_name);
+        Py_XINCREF(result);
+        Py_DECREF(run);
+    } else {
+        PyErr_Clear();
+    }
+
+    Py_DECREF(globals);
+    return result;
+}
+
 
 std::vector<float> process_python_array(const std::vector<float>& input_vector, const std::string& python_script) {
     std::vector<float> result_vector;
+    GilLock gil;
 
     npy_intp dimensions[1] = {static_cast<npy_intp>(input_vector.size())};
     PyObject* py_array = PyArray_SimpleNewFromData(1, dimensions, NPY_FLOAT32, const_cast<npy_float32 *>(input_vector.data()));
 
-    PyRun_SimpleString(
-            "import sys\n"
-            "class NullWriter:\n"
-            "    def write(self, msg): pass\n"
-            "    def flush(self): pass\n"
-            "sys.stdout = NullWriter()\n"
-            "sys.stderr = NullWriter()\n"
-    );
-
-    PyObject* main_module = PyImport_AddModule("__main__");
-    PyObject* global_dict = PyModule_GetDict(main_module);
-    PyDict_SetItemString(global_dict, "raw_audio_array", py_array);
-
-    PyRun_SimpleString(python_script.c_str());
+    PyObject* result = run_script(python_script, "raw_audio_array", py_array, "processed_audio_array");
 
-    PyObject* result = PyDict_GetItemString(global_dict, "processed_audio_array");
-
-    if (PyArray_Check(result)) {
+    if (result && PyArray_Check(result)) {
         auto* np_arr = reinterpret_cast<PyArrayObject*>(result);
 
         if (PyArray_TYPE(np_arr) != NPY_FLOAT32) {
@@ -51,6 +70,7 @@ std::vector<float> process_python_array(const std::vector<float>& input_vector,
         std::cerr << "Result is not a NumPy array" << std::endl;
     }
 
+    Py_XDECREF(result);
     Py_DECREF(py_array);
 
     return result_vector;
@@ -59,29 +79,15 @@ std::vector<float> process_python_array(const std::vector<float>& input_vector,
 
 std::string process_token_ids(const std::vector<int64_t>& token_ids, const std::string& python_script) {
     std::string tokens;
+    GilLock gil;
 
     npy_intp dimensions[1] = {static_cast<npy_intp>(token_ids.size())};
     PyObject* token_ids_np = PyArray_SimpleNewFromData(1, dimensions, NPY_INT64, const_cast<int64_t*>(token_ids.data()));
 
-    PyRun_SimpleString(
-            "import sys\n"
-            "class NullWriter:\n"
-            "    def write(self, msg): pass\n"
-            "    def flush(self): pass\n"
-            "sys.stdout = NullWriter()\n"
-            "sys.stderr = NullWriter()\n"
-    );
-
-    PyObject* main_module = PyImport_AddModule("__main__");
-    PyObject* global_dict = PyModule_GetDict(main_module);
-    PyDict_SetItemString(global_dict, "token_ids", token_ids_np);
-
-    PyRun_SimpleString(python_script.c_str());
-
-    PyObject* result = PyDict_GetItemString(global_dict, "token_string");
+    PyObject* result = run_script(python_script, "token_ids", token_ids_np, "token_string");
 
     // Check if the result is a string
-    if (PyUnicode_Check(result)) {
+    if (result && PyUnicode_Check(result)) {
         // Convert Python string to C++ string
         PyObject* result_bytes = PyUnicode_AsEncodedString(result, "utf-8", "strict");
         tokens = PyBytes_AS_STRING(result_bytes);
@@ -90,8 +96,8 @@ std::string process_token_ids(const std::vector<int64_t>& token_ids, const std::
         std::cerr << "Result is not a string" << std::endl;
     }
 
+    Py_XDECREF(result);
+    Py_DECREF(token_ids_np);
 
     return tokens;
 }
-
-
@@ -12,12 +12,29 @@
 #include "iostream"
 
 
+// Initialises the interpreter and then releases the GIL, so any thread may call the helpers below.
 class PythonEnvironment {
 public:
     PythonEnvironment();
     ~PythonEnvironment();
+
+private:
+    PyThreadState* main_thread_state = nullptr;
+};
+
+// Holds the GIL for the current thread; needed around every use of the Python C API.
+class GilLock {
+public:
+    GilLock() : state(PyGILState_Ensure()) {}
+    ~GilLock() { PyGILState_Release(state); }
+    GilLock(const GilLock&) = delete;
+    GilLock& operator=(const GilLock&) = delete;
+
+private:
+    PyGILState_STATE state;
 };
 
+// Both run the script in a fresh globals dict, so concurrent calls from several threads cannot see each other's data.
 std::vector<float> process_python_array(const std::vector<float>& input_vector, const std::string& python_script);
 std::string process_token_ids(const std::vector<int64_t>& token_ids, const std::string& python_script);
 